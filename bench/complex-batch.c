@@ -0,0 +1,14 @@
+#include <stdio.h>
+#include <complex.h>
+
+int main() {
+  double x, y;
+  double complex w;
+  x = 1e16;
+  y = (x + 1) - x;
+  // The real and imaginary parts of this go to the tool in a single
+  // batched request. The error of y should make it through both.
+  w = cexp(CMPLX(y, 0.0));
+  printf("%e\n", creal(w));
+  return 0;
+}
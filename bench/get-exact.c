@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <herbgrind.h>
+
+// Folded by the compiler, so it's never shadowed, and comparing
+// against it can't report a spot.
+#define THIRD (1.0 / 3.0)
+
+// Checks GET_EXACT and GET_EXACTF against values whose exact results
+// we know. Natively there are no shadows, so the checks only run
+// under herbgrind, and we never print a float so there are no marks.
+int main() {
+  double x, one, three;
+  double vals[3], out[6], buf[4];
+  float fx, fvals[2];
+  int ok = 1;
+  x = 1e16;
+  one = 1.0;
+  three = 3.0;
+  // Computed as 0, exactly 1.
+  vals[0] = (x + 1) - x;
+  // Exactly a third, which needs a second double to get closer to.
+  vals[1] = one / three;
+  // Never computed, so not shadowed.
+  vals[2] = 2.5;
+  fx = 1e8f;
+  // Computed as 0, exactly 1.
+  fvals[0] = (fx + 1) - fx;
+  fvals[1] = 0.5f;
+
+  if (RUNNING_ON_VALGRIND){
+    ok = ok && HERBGRIND_GET_EXACT(vals, out, 3, HERBGRIND_EXACT_DOUBLE) == 2;
+    ok = ok && out[0] == 1.0 && out[1] == THIRD && out[2] == 2.5;
+
+    ok = ok && HERBGRIND_GET_EXACT(vals, out, 3,
+                                   HERBGRIND_EXACT_DOUBLE_DOUBLE) == 2;
+    ok = ok && out[0] == 1.0 && out[1] == 0.0;
+    ok = ok && out[2] == THIRD && out[3] > 0.0 && out[3] < 1e-16;
+    ok = ok && out[4] == 2.5 && out[5] == 0.0;
+
+    ok = ok && HERBGRIND_GET_EXACTF(fvals, out, 2, HERBGRIND_EXACT_DOUBLE) == 1;
+    ok = ok && out[0] == 1.0 && out[1] == 0.5;
+
+    ok = ok && HERBGRIND_GET_EXACTF(fvals, out, 2,
+                                    HERBGRIND_EXACT_DOUBLE_DOUBLE) == 1;
+    ok = ok && out[0] == 1.0 && out[1] == 0.0;
+    ok = ok && out[2] == 0.5 && out[3] == 0.0;
+
+    // In place, where the second value's source is overwritten by
+    // the first value's low half.
+    buf[0] = vals[1];
+    buf[1] = (x + 1) - x;
+    ok = ok && HERBGRIND_GET_EXACT(buf, buf, 2,
+                                   HERBGRIND_EXACT_DOUBLE_DOUBLE) == 2;
+    ok = ok && buf[0] == THIRD && buf[1] > 0.0 && buf[1] < 1e-16;
+    ok = ok && buf[2] == 1.0 && buf[3] == 0.0;
+    ok = ok && HERBGRIND_GET_EXACT(vals, vals, 1, HERBGRIND_EXACT_DOUBLE) == 1;
+    ok = ok && vals[0] == 1.0;
+  }
+  printf("%s\n", ok ? "ok" : "wrong");
+  return 0;
+}
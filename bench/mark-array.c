@@ -0,0 +1,17 @@
+#include <stdio.h>
+#include <herbgrind.h>
+
+int main() {
+  double x, z;
+  double arr[6];
+  x = 1e16;
+  z = 1e17;
+  // Only the even elements are marked, so only the first expression
+  // should be reported.
+  for(int i = 0; i < 6; i += 2){
+    arr[i] = (x + 1) - x;
+    arr[i + 1] = (z + 1) - z;
+  }
+  HERBGRIND_MARK_IMPORTANT_ARRAY(arr, 3, 2, HERBGRIND_DOUBLE);
+  return 0;
+}
@@ -0,0 +1,12 @@
+#include <stdio.h>
+#include <math.h>
+
+int main() {
+  double x,y;
+  FILE* out = fopen("/dev/null", "w");
+  x = 1e16;
+  y = (x + 1) - x;
+  fwrite(&y, sizeof(double), 1, out);
+  fclose(out);
+  return 0;
+}
@@ -0,0 +1,20 @@
+#include <stdio.h>
+#include <math.h>
+#include <herbgrind.h>
+#include <mathreplace-funcs.h>
+
+int main() {
+  double x,y,z;
+  x = 1e16;
+  y = (x + 1) - x;
+  printf("%e\n", y);
+  HERBGRIND_END();
+  // Outside the region, neither of these should make an op, even
+  // though y still has a shadow from inside it. If they did, z
+  // would get a very wrong shadow and be marked below.
+  z = exp(y);
+  HERBGRIND_PERFORM_OP(OP_EXP, &z, &y);
+  HERBGRIND_BEGIN();
+  printf("%e\n", z);
+  return 0;
+}
@@ -0,0 +1,16 @@
+#include <stdio.h>
+#include <herbgrind.h>
+
+int main() {
+  double x, y, z, w;
+  x = 1e16;
+  y = (x + 1) - x;
+  printf("%e\n", y);
+  // Nothing from before here should show up in either output.
+  HERBGRIND_RESET_STATS();
+  z = 1e17;
+  w = (z + 1) - z;
+  printf("%e\n", w);
+  HERBGRIND_DUMP_STATS("phase2");
+  return 0;
+}
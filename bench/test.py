@@ -1,5 +1,6 @@
 #!/usr/bin/env python3
 
+import glob
 import subprocess
 import sys
 import re
@@ -12,26 +13,12 @@ def compare_results(actual, expected):
     # print("Comparing: {} and {}".format(sanitize(actual), sanitize(expected)))
     return sanitize(actual) == sanitize(expected)
 
-def test(prog):
-    command = ["./valgrind/herbgrind-install/bin/valgrind", "--tool=herbgrind",
-               "--output-sexp", prog]
-    print("Calling `{}`...".format(" ".join(command)), end=" ")
-    proc = subprocess.Popen(command, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
-    stdout, stderr = proc.communicate()
-    status = proc.poll()
-    full_stderr = stderr.decode('utf-8')
-    stderr_lines = full_stderr.splitlines()
-    last_stderr = "\n".join(stderr_lines[-200:])
-
-    if status:
-        print("Command failed (status {}).".format(status))
-        return False
-
+def check_output(actual_file, expected_file, stdout, last_stderr):
     try:
-        with open(prog + ".gh") as actual, open(prog + ".expected") as expected:
+        with open(actual_file) as actual, open(expected_file) as expected:
             actual_text, expected_text = actual.read(), expected.read()
     except:
-        print("Cannot find output file {}!".format(prog + ".gh"),
+        print("Cannot find output file {}!".format(actual_file),
               "stdout::", stdout.decode('utf-8'),
               "stderr::", last_stderr,
               sep="\n")
@@ -39,15 +26,72 @@ def test(prog):
 
     if not compare_results(actual_text, expected_text):
         if actual_text == "":
-            print("Empty file at {}!".format(prog + ".gh"))
+            print("Empty file at {}!".format(actual_file))
         if expected_text == "":
-            print("Empty file at {}!".format(prog + ".expected"))
+            print("Empty file at {}!".format(expected_file))
         print("Outputs do not match!")
         print("Actual::", actual_text, sep="\n")
         print("Expected::", expected_text, sep="\n")
         print("stdout::", stdout.decode('utf-8'), sep="\n")
         print("stderr::", last_stderr, sep="\n")
         return False
+    return True
+
+# Extra herbgrind flags for a test can go in prog.flags.
+def read_flags(prog):
+    try:
+        with open(prog + ".flags") as f:
+            return f.read().split()
+    except FileNotFoundError:
+        return []
+
+def run_herbgrind(prog, flags):
+    command = ["./valgrind/herbgrind-install/bin/valgrind", "--tool=herbgrind",
+               "--output-sexp"] + flags + [prog]
+    print("Calling `{}`...".format(" ".join(command)), end=" ")
+    proc = subprocess.Popen(command, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    stdout, stderr = proc.communicate()
+    status = proc.poll()
+    full_stderr = stderr.decode('utf-8')
+    stderr_lines = full_stderr.splitlines()
+    last_stderr = "\n".join(stderr_lines[-200:])
+
+    if status:
+        print("Command failed (status {}).".format(status))
+        return None, last_stderr
+    return stdout, last_stderr
+
+def test(prog):
+    flags = read_flags(prog)
+    stdout, last_stderr = run_herbgrind(prog, flags)
+    if stdout is None:
+        return False
+
+    # Binary output is converted to prog.gh like the text output
+    # would be, and then checked against a text run of the same
+    # program.
+    if "--output-binary" in flags:
+        convert = ["python3", "ghb-convert.py", prog + ".ghb", prog + ".gh",
+                   "--sexp"]
+        if subprocess.call(convert):
+            print("Couldn't convert {}!".format(prog + ".ghb"))
+            return False
+        text_flags = [flag for flag in flags if flag != "--output-binary"]
+        text_stdout, text_stderr = \
+            run_herbgrind(prog, text_flags + ["--outfile=" + prog + ".text.gh"])
+        if text_stdout is None:
+            return False
+        if not check_output(prog + ".gh", prog + ".text.gh",
+                            text_stdout, text_stderr):
+            return False
+
+    # Besides the final output, prog.expected.<label> is checked
+    # against the stats dump with that label.
+    for expected_file in [prog + ".expected"] + \
+        sorted(glob.glob(prog + ".expected.*")):
+        actual_file = prog + ".gh" + expected_file[len(prog + ".expected"):]
+        if not check_output(actual_file, expected_file, stdout, last_stderr):
+            return False
 
     native_proc = subprocess.Popen([prog], stdout=subprocess.PIPE, stderr=subprocess.PIPE)
     native_stdout, native_stderr = native_proc.communicate()
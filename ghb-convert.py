@@ -0,0 +1,648 @@
+#!/usr/bin/env python
+
+#--------------------------------------------------------------------#
+#--- HerbGrind: a valgrind tool for Herbie         ghb-convert.py ---#
+#--------------------------------------------------------------------#
+
+
+   # This file is part of HerbGrind, a valgrind tool for diagnosing
+   # floating point accuracy problems in binary programs and extracting
+   # problematic expressions.
+
+   # Copyright (C) 2016-2017 Alex Sanchez-Stern
+
+   # This program is free software; you can redistribute it and/or
+   # modify it under the terms of the GNU General Public License as
+   # published by the Free Software Foundation; either version 3 of the
+   # License, or (at your option) any later version.
+
+   # This program is distributed in the hope that it will be useful, but
+   # WITHOUT ANY WARRANTY; without even the implied warranty of
+   # MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   # General Public License for more details.
+
+   # You should have received a copy of the GNU General Public License
+   # along with this program; if not, write to the Free Software
+   # Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   # 02111-1307, USA.
+
+   # The GNU General Public License is contained in the file COPYING.
+
+# Turns the binary output written with --output-binary, or the
+# snapshot files written with --snapshot-interval (see
+# src/runtime/op-shadowstate/binary-output.h for the format), into the
+# usual text output, or with --sexp, the --output-sexp format.
+
+import argparse
+import struct
+import sys
+
+GHB_MAGIC = b"GHB1"
+GHB_VERSION = 3
+
+GHB_FLAG_DETAILED_RANGES = 0x1
+GHB_FLAG_USE_RANGES = 0x2
+GHB_FLAG_FPCORE_RANGES = 0x4
+GHB_FLAG_FLIP_RANGES = 0x8
+GHB_FLAG_NO_EXPRS = 0x10
+GHB_FLAG_ERROR_QUANTILES = 0x20
+
+GHB_NODE_CONST = 0
+GHB_NODE_VAR = 1
+GHB_NODE_OP = 2
+
+ERROR_HISTOGRAM_BINS = 65
+INPUT_HISTOGRAM_BINADE_SHIFT = 2
+INPUT_HISTOGRAM_BINS_PER_SIGN = 2048 >> INPUT_HISTOGRAM_BINADE_SHIFT
+INPUT_HISTOGRAM_BINS = INPUT_HISTOGRAM_BINS_PER_SIGN * 2
+
+varnames = ["x", "y", "z", "a", "b", "c",
+            "i", "j", "k", "l", "m", "n"]
+
+def getVar(idx):
+    if idx < len(varnames):
+        return varnames[idx]
+    return "x%d" % (idx - len(varnames))
+
+def varString(numVars):
+    return "(" + " ".join(getVar(i) for i in range(numVars)) + ")"
+
+def pFloat(val):
+    if val != val:
+        return "+nan.0"
+    if val == float("inf"):
+        return "+inf.0"
+    if val == float("-inf"):
+        return "-inf.0"
+    i = 0
+    if 0 < val < 1 or -1 < val < 0:
+        while -1 < val < 1:
+            val *= 10
+            i += 1
+        return "%fe-%d" % (val, i)
+    if val >= 9.9999999 or val <= -9.9999999:
+        while val >= 9.9999999 or val <= -9.9999999:
+            val /= 10
+            i += 1
+        return "%fe%d" % (val, i)
+    return "%f" % val
+
+class Reader(object):
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+    def done(self):
+        return self.pos >= len(self.data)
+    def read(self, fmt):
+        vals = struct.unpack_from("=" + fmt, self.data, self.pos)
+        self.pos += struct.calcsize("=" + fmt)
+        return vals
+    def u8(self):
+        return self.read("B")[0]
+    def u32(self):
+        return self.read("I")[0]
+    def u64(self):
+        return self.read("Q")[0]
+    def i64(self):
+        return self.read("q")[0]
+    def f64(self):
+        return self.read("d")[0]
+    def bytes(self, n):
+        result = self.data[self.pos:self.pos + n]
+        self.pos += n
+        return result
+
+class ErrorStats(object):
+    def __init__(self, r):
+        self.max_error = r.f64()
+        self.total_error = r.f64()
+        self.num_evals = r.i64()
+        self.bins = r.read("%dQ" % ERROR_HISTOGRAM_BINS)
+    def avg(self, num_evals=None):
+        if num_evals is None:
+            num_evals = self.num_evals
+        if num_evals == 0:
+            return float("nan")
+        return self.total_error / num_evals
+    # Mirrors errorQuantile in shadowop-info.c
+    def quantile(self, q):
+        total = sum(self.bins)
+        if total == 0:
+            return 0.0
+        target = q * total
+        seen = 0
+        for i, count in enumerate(self.bins):
+            if count == 0:
+                continue
+            if seen + count >= target:
+                frac = (target - seen) / float(count)
+                return min(i + frac, self.max_error)
+            seen += count
+        return self.max_error
+
+class Location(object):
+    def __init__(self, r, strings, addr):
+        self.addr = addr
+        self.fnname = strings[r.u32()]
+        self.filename = strings[r.u32()]
+        self.line = r.u32()
+        self.objname = strings[r.u32()]
+    def addrString(self, print_object_files):
+        if self.line != 0xffffffff:
+            result = "%s:%u in %s (addr %X)" % (self.filename, self.line,
+                                                self.fnname, self.addr)
+        else:
+            result = "addr %X" % self.addr
+        if print_object_files:
+            result += " in %s" % self.objname
+        return result
+
+class Range(object):
+    def __init__(self, r):
+        (self.pos_min, self.pos_max,
+         self.neg_min, self.neg_max) = r.read("4d")
+
+class Var(object):
+    def __init__(self, r):
+        self.total = Range(r)
+        self.problematic = Range(r)
+        self.example = r.f64()
+        if r.u8():
+            self.histogram = [0] * INPUT_HISTOGRAM_BINS
+            for _ in range(r.u32()):
+                binIdx = r.u32()
+                self.histogram[binIdx] = r.u32()
+        else:
+            self.histogram = None
+
+class Op(object):
+    def __init__(self, r, strings):
+        self.op_id = r.u32()
+        addr = r.u64()
+        self.loc = Location(r, strings, addr)
+        self.global_error = ErrorStats(r)
+        self.local_error = ErrorStats(r)
+        self.root = r.u32()
+        self.vars = [Var(r) for _ in range(r.u32())]
+
+class Mark(object):
+    def __init__(self, r, strings):
+        addr = r.u64()
+        self.argIdx = r.u32()
+        self.nmarks = r.u32()
+        self.loc = Location(r, strings, addr)
+        self.eagg = ErrorStats(r)
+        self.root = r.u32()
+        self.influences = [r.u32() for _ in range(r.u32())]
+    def key(self):
+        return ("M", self.loc.addr, self.argIdx)
+
+class IntMark(object):
+    def __init__(self, r, strings):
+        self.markType = strings[r.u32()]
+        addr = r.u64()
+        self.loc = Location(r, strings, addr)
+        self.num_hits = r.i64()
+        self.num_mismatches = r.i64()
+        self.roots = [r.u32() for _ in range(r.u32())]
+        self.influences = [r.u32() for _ in range(r.u32())]
+    def key(self):
+        return ("I", self.markType, self.loc.addr)
+
+class Report(object):
+    def __init__(self, data):
+        try:
+            self.read(data)
+        except struct.error:
+            # A file that was cut off partway through. Fall back to
+            # the last complete snapshot, if there was one.
+            if self.lastCheckpoint is None:
+                raise ValueError("truncated file with no complete snapshot")
+            sys.stderr.write("Truncated file, using snapshot %d\n" %
+                             self.lastCheckpointNum)
+            self.read(data[:self.lastCheckpoint])
+
+    def read(self, data):
+        r = Reader(data)
+        if r.bytes(4) != GHB_MAGIC:
+            raise ValueError("not a herbgrind binary output file")
+        version = r.u32()
+        if version != GHB_VERSION:
+            raise ValueError("unsupported format version %d" % version)
+        self.flags = r.u8()
+        self.strings = {}
+        self.nodes = {}
+        self.ops = {}
+        # Later records for the same mark replace earlier ones, but
+        # keep the position of the first.
+        self.entries = {}
+        self.entryOrder = []
+        self.lastCheckpoint = None
+        self.lastCheckpointNum = None
+        while not r.done():
+            tag = chr(r.u8())
+            if tag == 'S':
+                sid = r.u32()
+                self.strings[sid] = r.bytes(r.u32()).decode("utf-8", "replace")
+            elif tag == 'E':
+                self.readNode(r)
+            elif tag == 'O':
+                op = Op(r, self.strings)
+                self.ops[op.op_id] = op
+            elif tag == 'M':
+                self.addEntry(Mark(r, self.strings))
+            elif tag == 'I':
+                self.addEntry(IntMark(r, self.strings))
+            elif tag == 'C':
+                self.lastCheckpointNum = r.u32()
+                self.lastCheckpoint = r.pos
+            else:
+                raise ValueError("bad record tag %r at offset %d" %
+                                 (tag, r.pos - 1))
+    def addEntry(self, entry):
+        key = entry.key()
+        if key not in self.entries:
+            self.entryOrder.append(key)
+        self.entries[key] = entry
+    def orderedEntries(self):
+        return [self.entries[key] for key in self.entryOrder]
+    def readNode(self, r):
+        nid = r.u32()
+        kind = r.u8()
+        if kind == GHB_NODE_CONST:
+            self.nodes[nid] = (kind, r.f64())
+        elif kind == GHB_NODE_VAR:
+            self.nodes[nid] = (kind, r.u32())
+        elif kind == GHB_NODE_OP:
+            sym = self.strings[r.u32()]
+            r.u64()
+            args = [r.u32() for _ in range(r.u32())]
+            self.nodes[nid] = (kind, sym, args)
+        else:
+            raise ValueError("bad node kind %d" % kind)
+    def flag(self, f):
+        return (self.flags & f) != 0
+    def exprString(self, nid):
+        node = self.nodes[nid]
+        if node[0] == GHB_NODE_CONST:
+            return pFloat(node[1])
+        if node[0] == GHB_NODE_VAR:
+            return getVar(node[1])
+        return "(%s" % node[1] + "".join(" " + self.exprString(a)
+                                          for a in node[2]) + ")"
+    def numVars(self, nid):
+        node = self.nodes[nid]
+        if node[0] == GHB_NODE_VAR:
+            return node[1] + 1
+        if node[0] == GHB_NODE_OP:
+            return max([0] + [self.numVars(a) for a in node[2]])
+        return 0
+
+class Printer(object):
+    def __init__(self, report, sexp, print_object_files):
+        self.report = report
+        self.sexp = sexp
+        self.print_object_files = print_object_files
+        self.detailed = report.flag(GHB_FLAG_DETAILED_RANGES)
+        self.use_ranges = report.flag(GHB_FLAG_USE_RANGES)
+        self.fpcore_ranges = report.flag(GHB_FLAG_FPCORE_RANGES)
+        self.flip_ranges = report.flag(GHB_FLAG_FLIP_RANGES)
+        self.no_exprs = report.flag(GHB_FLAG_NO_EXPRS)
+        self.error_quantiles = report.flag(GHB_FLAG_ERROR_QUANTILES)
+        self.out = []
+
+    def p(self, s):
+        self.out.append(s)
+
+    def fpcore(self, root):
+        if root == 0:
+            return "()", ""
+        return (varString(self.report.numVars(root)),
+                self.report.exprString(root))
+
+    def nonTrivialRange(self, rng):
+        if self.detailed:
+            return True
+        return (rng.pos_min != float("-inf") or
+                rng.pos_max != float("inf"))
+
+    def precondition(self, name, rng):
+        inf = float("inf")
+        def between(lo, hi):
+            return " (and (<= %s %s) (<= %s %s))" % (pFloat(lo), name,
+                                                     name, pFloat(hi))
+        if not self.detailed:
+            if rng.pos_min == -inf:
+                return " (<= %s %s)" % (name, pFloat(rng.pos_max))
+            if rng.pos_max == inf:
+                return " (<= %s %s)" % (pFloat(rng.pos_min), name)
+            return between(rng.pos_min, rng.pos_max)
+        if rng.neg_min == inf:
+            if rng.pos_max == inf:
+                return " (<= %s %s)" % (pFloat(rng.pos_min), name)
+            return between(rng.pos_min, rng.pos_max)
+        if rng.pos_min == inf:
+            if rng.neg_min == -inf:
+                return " (<= %s %s)" % (name, pFloat(rng.neg_max))
+            return between(rng.neg_min, rng.neg_max)
+        result = " (or"
+        if rng.neg_min == -inf:
+            result += " (<= %s %s)" % (name, pFloat(rng.neg_max))
+        else:
+            result += between(rng.neg_min, rng.neg_max)
+        if rng.pos_max == inf:
+            result += " (<= %s %s)" % (pFloat(rng.pos_min), name)
+        else:
+            result += between(rng.pos_min, rng.pos_max)
+        return result + ")"
+
+    def writePreconditions(self, op):
+        if not (self.fpcore_ranges and self.use_ranges):
+            return
+        ranges = [v.problematic if self.flip_ranges else v.total
+                  for v in op.vars]
+        nonTrivial = [i for i, rng in enumerate(ranges)
+                      if self.nonTrivialRange(rng)]
+        if not nonTrivial:
+            return
+        self.p("      :pre (and" if len(nonTrivial) > 1 else "      :pre")
+        for i in nonTrivial:
+            self.p(self.precondition(getVar(i), ranges[i]))
+        self.p(")\n" if len(nonTrivial) > 1 else "\n")
+
+    def writeRanges(self, label, textLabel, ranges):
+        if self.sexp:
+            self.p("     (%s" % label)
+            for i, rng in enumerate(ranges):
+                self.p("\n       (%s\n" % getVar(i))
+                if self.detailed:
+                    self.p("         (neg-range-min %s)\n"
+                           "         (neg-range-max %s)\n"
+                           "         (pos-range-min %s)\n"
+                           "         (pos-range-max %s))" %
+                           (pFloat(rng.neg_min), pFloat(rng.neg_max),
+                            pFloat(rng.pos_min), pFloat(rng.pos_max)))
+                else:
+                    self.p("         (range-min %s)\n"
+                           "         (range-max %s))" %
+                           (pFloat(rng.pos_min), pFloat(rng.pos_max)))
+            self.p(")\n")
+        elif self.detailed:
+            for sign, lo, hi in (("Positive", "pos_min", "pos_max"),
+                                 ("Negative", "neg_min", "neg_max")):
+                self.p("   %s %s:\n" % (sign, textLabel[1]))
+                for i, rng in enumerate(ranges):
+                    self.p("        %s <= %s <= %s\n" %
+                           (pFloat(getattr(rng, lo)), getVar(i),
+                            pFloat(getattr(rng, hi))))
+        else:
+            self.p("   %s:" % textLabel[0])
+            self.p(",".join(" %s <= %s <= %s" %
+                            (pFloat(rng.pos_min), getVar(i),
+                             pFloat(rng.pos_max))
+                            for i, rng in enumerate(ranges)))
+            self.p("\n")
+
+    def writeTotalRanges(self, op):
+        self.writeRanges("var-ranges", ("Inputs", "Values"),
+                         [v.total for v in op.vars])
+
+    def writeProblematicRanges(self, op):
+        self.writeRanges("var-problematic-ranges",
+                         ("Problematic inputs", "Problematic Values"),
+                         [v.problematic for v in op.vars])
+
+    def histogramString(self, histogram):
+        result = ""
+        for i, count in enumerate(histogram):
+            if count == 0:
+                continue
+            exponentBin = i % INPUT_HISTOGRAM_BINS_PER_SIGN
+            lo = (exponentBin << INPUT_HISTOGRAM_BINADE_SHIFT) - 1023
+            hi = ((exponentBin + 1) << INPUT_HISTOGRAM_BINADE_SHIFT) - 1023
+            negative = i >= INPUT_HISTOGRAM_BINS_PER_SIGN
+            if self.sexp:
+                result += " (%s %d %d %d)" % ("-" if negative else "+",
+                                             lo, hi, count)
+            else:
+                result += " %s[2^%d, 2^%d): %d" % ("-" if negative else "",
+                                                   lo, hi, count)
+        return result
+
+    def writeHistograms(self, op):
+        if not any(v.histogram is not None for v in op.vars):
+            return
+        if self.sexp:
+            self.p("     (var-input-histograms")
+            for i, v in enumerate(op.vars):
+                if v.histogram is not None:
+                    self.p("\n       (%s%s)" %
+                           (getVar(i), self.histogramString(v.histogram)))
+            self.p(")\n")
+        else:
+            for i, v in enumerate(op.vars):
+                if v.histogram is not None:
+                    self.p("      %s magnitudes:%s\n" %
+                           (getVar(i), self.histogramString(v.histogram)))
+
+    def writeExample(self, op):
+        example = ", ".join(pFloat(v.example) for v in op.vars)
+        if self.sexp:
+            self.p("     (example problematic input (%s))\n" % example)
+        else:
+            self.p("   Example problematic input: (%s)\n" % example)
+
+    def writeInfluence(self, op):
+        vars_, expr = self.fpcore(op.root)
+        g = op.global_error
+        l = op.local_error
+        if self.sexp:
+            self.p("    (")
+            if not self.no_exprs:
+                self.p("\n     (expr\n       (FPCore %s\n" % vars_)
+                self.writePreconditions(op)
+                self.p("         %s))\n" % expr)
+                if self.use_ranges:
+                    if not self.fpcore_ranges or not self.flip_ranges:
+                        self.writeProblematicRanges(op)
+                    if not self.fpcore_ranges or self.flip_ranges:
+                        self.writeTotalRanges(op)
+                    self.writeHistograms(op)
+                self.writeExample(op)
+            self.p("     (function \"%s\")\n"
+                   "     (filename \"%s\")\n"
+                   "     (line-num %u)\n"
+                   "     (instr-addr %X)\n" %
+                   (op.loc.fnname, op.loc.filename, op.loc.line,
+                    op.loc.addr))
+            if self.print_object_files:
+                self.p("    (objectfile \"%s\")\n" % op.loc.objname)
+            self.p("     (avg-error %f)\n"
+                   "     (max-error %f)\n"
+                   "     (avg-local-error %f)\n"
+                   "     (max-local-error %f)\n" %
+                   (g.avg(), g.max_error, l.avg(g.num_evals), l.max_error))
+            if self.error_quantiles:
+                self.p("     (p50-error %f)\n"
+                       "     (p90-error %f)\n"
+                       "     (p99-error %f)\n"
+                       "     (p99-local-error %f)\n" %
+                       (g.quantile(0.5), g.quantile(0.9), g.quantile(0.99),
+                        l.quantile(0.99)))
+            self.p("     (num-calls %d))\n" % g.num_evals)
+        else:
+            if not self.no_exprs:
+                self.p("\n    (FPCore %s\n" % vars_)
+                self.writePreconditions(op)
+                self.p("         %s)\n" % expr)
+            self.p("   %s\n" % op.loc.addrString(self.print_object_files))
+            if op.vars and self.use_ranges and not self.no_exprs:
+                if not self.fpcore_ranges or self.flip_ranges:
+                    self.writeTotalRanges(op)
+                if not self.fpcore_ranges or not self.flip_ranges:
+                    self.writeProblematicRanges(op)
+                self.writeHistograms(op)
+                self.writeExample(op)
+            self.p("   %f bits average error\n"
+                   "   %f bits max error\n"
+                   "   %f bits average local error\n"
+                   "   %f bits max local error\n" %
+                   (g.avg(), g.max_error, l.avg(g.num_evals), l.max_error))
+            if self.error_quantiles:
+                self.p("   %f/%f/%f bits error at the 50th/90th/99th percentiles\n"
+                       "   %f bits local error at the 99th percentile\n" %
+                       (g.quantile(0.5), g.quantile(0.9), g.quantile(0.99),
+                        l.quantile(0.99)))
+            self.p("   Aggregated over %d instances\n" % g.num_evals)
+
+    def writeInfluences(self, influences):
+        if not influences and not self.sexp:
+            self.p("\nNo influences found!\n\n")
+        if self.sexp:
+            self.p("    (\n")
+        for op_id in influences:
+            if op_id in self.report.ops:
+                self.writeInfluence(self.report.ops[op_id])
+        if self.sexp:
+            self.p("    )\n")
+
+    def writeMark(self, mark):
+        e = mark.eagg
+        loc = mark.loc
+        if self.sexp:
+            self.p("(output\n"
+                   "  (argIdx %d)\n"
+                   "  (function \"%s\")\n"
+                   "  (filename \"%s\")\n"
+                   "  (line-num %u)\n"
+                   "  (instr-addr %X)\n" %
+                   (mark.argIdx, loc.fnname, loc.filename, loc.line,
+                    loc.addr))
+            if self.print_object_files:
+                self.p("  (objectfile \"%s\")\n" % loc.objname)
+            if mark.root != 0:
+                self.p("  (full-expr \n    (FPCore %s\n     %s))\n" %
+                       self.fpcore(mark.root))
+            self.p("  (avg-error %f)\n"
+                   "  (max-error %f)\n" % (e.avg(), e.max_error))
+            if self.error_quantiles:
+                self.p("  (p50-error %f)\n"
+                       "  (p90-error %f)\n"
+                       "  (p99-error %f)\n" %
+                       (e.quantile(0.5), e.quantile(0.9), e.quantile(0.99)))
+            self.p("  (num-calls %d)\n"
+                   "  (influences\n" % e.num_evals)
+        else:
+            if mark.nmarks > 1:
+                self.p("Output, float arg #%d\n" % (mark.argIdx + 1))
+            else:
+                self.p("Output")
+            self.p(" @ %s\n" % loc.addrString(self.print_object_files))
+            if mark.root != 0:
+                self.p("  Full expr:\n    (FPCore %s\n     %s))\n" %
+                       self.fpcore(mark.root))
+            self.p("%f bits average error\n"
+                   "%f bits max error\n" % (e.avg(), e.max_error))
+            if self.error_quantiles:
+                self.p("%f/%f/%f bits error at the 50th/90th/99th percentiles\n" %
+                       (e.quantile(0.5), e.quantile(0.9), e.quantile(0.99)))
+            self.p("Aggregated over %d instances\n"
+                   "Influenced by erroneous expression:\n" % e.num_evals)
+        self.writeInfluences(mark.influences)
+        if self.sexp:
+            self.p("  )\n)")
+        self.p("\n")
+
+    def writeIntMark(self, mark):
+        loc = mark.loc
+        percent = (mark.num_mismatches * 100) // mark.num_hits
+        if self.sexp:
+            self.p("(%s\n"
+                   "  (function \"%s\")\n"
+                   "  (filename \"%s\")\n"
+                   "  (line-num %u)\n"
+                   "  (instr-addr %X)\n" %
+                   (mark.markType, loc.fnname, loc.filename, loc.line,
+                    loc.addr))
+            if self.print_object_files:
+                self.p("  (objectfile \"%s\")\n" % loc.objname)
+            if any(root != 0 for root in mark.roots):
+                self.p("  (full-exprs \n")
+                for root in mark.roots:
+                    self.p("    (FPCore %s\n     %s)\n" % self.fpcore(root))
+                self.p("    )\n")
+            self.p("  (percent-wrong %d)\n"
+                   "  (num-wrong %d)\n"
+                   "  (num-calls %d)\n"
+                   "  (influences\n" %
+                   (percent, mark.num_mismatches, mark.num_hits))
+        else:
+            self.p("%s @ %s\n" % (mark.markType,
+                                  loc.addrString(self.print_object_files)))
+            if any(root != 0 for root in mark.roots):
+                self.p("Full exprs:\n")
+                for root in mark.roots:
+                    self.p("    (FPCore %s\n     %s)\n" % self.fpcore(root))
+            self.p("%d%% incorrect\n"
+                   "%d incorrect values\n"
+                   "%d total instances\n"
+                   "Influenced by erroneous expressions:\n" %
+                   (percent, mark.num_mismatches, mark.num_hits))
+        self.writeInfluences(mark.influences)
+        if self.sexp:
+            self.p("  )\n)\n\n")
+
+    def render(self):
+        entries = self.report.orderedEntries()
+        if not entries:
+            return "" if self.sexp else "No marks found!\n"
+        for entry in entries:
+            if isinstance(entry, Mark):
+                self.writeMark(entry)
+            else:
+                self.writeIntMark(entry)
+        return "".join(self.out)
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Convert herbgrind binary (.ghb) output to text.")
+    parser.add_argument("infile", help="the .ghb file to read")
+    parser.add_argument("outfile", nargs="?",
+                        help="where to write the output [stdout]")
+    parser.add_argument("--sexp", action="store_true",
+                        help="write the --output-sexp format")
+    parser.add_argument("--print-object-files", action="store_true",
+                        help="also print the object file of each address")
+    args = parser.parse_args()
+
+    with open(args.infile, "rb") as f:
+        report = Report(f.read())
+    output = Printer(report, args.sexp, args.print_object_files).render()
+    if args.outfile:
+        with open(args.outfile, "w") as f:
+            f.write(output)
+    else:
+        sys.stdout.write(output)
+
+if __name__ == "__main__":
+    main()
@@ -39,6 +39,11 @@
 #define LIBM libmZdsoZa
 #define LIBM_CPP libmZhZaZdsoZa
 #define LIBGCC libgccZa
+#define LIBMVEC libmvecZdsoZa
+
+// Passing our return address along saves the tool from walking the
+// stack on every call to find out where it came from.
+#define CALL_ADDR __builtin_return_address(0)
 
 // This file instructs valgrind to capture calls to the math functions
 // listed in hg_mathreplace_funcs.h, and redirect them to the
@@ -51,6 +56,18 @@
 // only accurate to 64 bits.
 
 
+// Complex ops have a real and an imaginary part, which we hand to the
+// tool together so they only cost one client request. The args and
+// results are doubles for both precisions, so this works the same
+// for the single precision functions.
+#define PERFORM_COMPLEX_OP(opname, rResult, iResult, args)              \
+  {                                                                     \
+    HerbgrindOpRecord records[2] =                                      \
+      {{opname##R, &(rResult), args},                                   \
+       {opname##I, &(iResult), args}};                                  \
+    HERBGRIND_PERFORM_OP_BATCH_AT(records, 2, CALL_ADDR);               \
+  }
+
 /*----------------------------
 ====== Unary Ops =============
 ----------------------------*/
@@ -61,7 +78,7 @@
     double result;                                              \
     double args[1];                                             \
     args[0] = x;                                              \
-    HERBGRIND_PERFORM_OP(opname, &result, args);              \
+    HERBGRIND_PERFORM_OP_AT(opname, &result, args, CALL_ADDR); \
     return result;                                            \
   }
 #define WRAP_UNARY_32_(soname, fnname, opname)             \
@@ -70,7 +87,7 @@
     float result;                                              \
     float args[1];                                             \
     args[0] = x;                                              \
-    HERBGRIND_PERFORM_OPF(opname, &result, args);              \
+    HERBGRIND_PERFORM_OPF_AT(opname, &result, args, CALL_ADDR); \
     return result;                                            \
   }
 
@@ -90,8 +107,7 @@
     double args[2];                                                       \
     args[0] = creal(x);                                                 \
     args[1] = cimag(x);                                                 \
-    HERBGRIND_PERFORM_OP(opname##R, &rResult, args);                    \
-    HERBGRIND_PERFORM_OP(opname##I, &iResult, args);                    \
+    PERFORM_COMPLEX_OP(opname, rResult, iResult, args);                 \
     return rResult + iResult * I;                                       \
   }
 #define WRAP_UNARY_COMPLEX_32_(soname, fnname, opname)            \
@@ -101,8 +117,7 @@
     double args[2];                                                       \
     args[0] = creal(x);                                                 \
     args[1] = cimag(x);                                                 \
-    HERBGRIND_PERFORM_OPF(opname##R, &rResult, args);                    \
-    HERBGRIND_PERFORM_OPF(opname##I, &iResult, args);                    \
+    PERFORM_COMPLEX_OP(opname, rResult, iResult, args);                 \
     return rResult + iResult * I;                                       \
   }
 
@@ -145,7 +160,7 @@ WRAP_UNARY_OPS
     double args[2];                                              \
     args[0] = x;                                                 \
     args[1] = y;                                                 \
-    HERBGRIND_PERFORM_OP(opname, &result, args);                 \
+    HERBGRIND_PERFORM_OP_AT(opname, &result, args, CALL_ADDR);   \
     return result;                                               \
   }
 #define WRAP_BINARY_32_(soname, fnname, opname)              \
@@ -155,7 +170,7 @@ WRAP_UNARY_OPS
     float args[2];                                              \
     args[0] = x;                                                 \
     args[1] = y;                                                 \
-    HERBGRIND_PERFORM_OPF(opname, &result, args);                 \
+    HERBGRIND_PERFORM_OPF_AT(opname, &result, args, CALL_ADDR);   \
     return result;                                               \
   }
 
@@ -179,8 +194,7 @@ WRAP_UNARY_OPS
     args[1] = cimag(x);                                                 \
     args[2] = creal(y);                                                 \
     args[3] = cimag(y);                                                 \
-    HERBGRIND_PERFORM_OP(opname##R, &rResult, args);                    \
-    HERBGRIND_PERFORM_OP(opname##I, &iResult, args);                    \
+    PERFORM_COMPLEX_OP(opname, rResult, iResult, args);                 \
     return rResult + iResult * I;                                       \
   }
 #define WRAP_BINARY_COMPLEX_32_(soname, fnname, opname)              \
@@ -194,8 +208,7 @@ WRAP_UNARY_OPS
     args[1] = cimag(x);                                                 \
     args[2] = creal(y);                                                 \
     args[3] = cimag(y);                                                 \
-    HERBGRIND_PERFORM_OPF(opname##R, &rResult, args);                    \
-    HERBGRIND_PERFORM_OPF(opname##I, &iResult, args);                    \
+    PERFORM_COMPLEX_OP(opname, rResult, iResult, args);                 \
     return rResult + iResult * I;                                       \
   }
 #define WRAP_BINARY_COMPLEX_64(fnname, opname)             \
@@ -225,7 +238,7 @@ WRAP_BINARY_OPS
     args[0] = x;                                                        \
     args[1] = y;                                                        \
     args[2] = z;                                                        \
-    HERBGRIND_PERFORM_OP(opname, &result, args);                        \
+    HERBGRIND_PERFORM_OP_AT(opname, &result, args, CALL_ADDR);          \
     return result;                                                      \
   }
 #define WRAP_TERNARY_32_(soname, fnname, opname)                     \
@@ -236,7 +249,7 @@ WRAP_BINARY_OPS
     args[0] = x;                                                        \
     args[1] = y;                                                        \
     args[2] = z;                                                        \
-    HERBGRIND_PERFORM_OPF(opname, &result, args);                        \
+    HERBGRIND_PERFORM_OPF_AT(opname, &result, args, CALL_ADDR);          \
     return result;                                                      \
   }
 
@@ -264,8 +277,7 @@ WRAP_BINARY_OPS
     args[3] = cimag(x);                                                 \
     args[4] = creal(x);                                                 \
     args[5] = cimag(x);                                                 \
-    HERBGRIND_PERFORM_OP(opname##R, &rResult, args);                    \
-    HERBGRIND_PERFORM_OP(opname##I, &iResult, args);                    \
+    PERFORM_COMPLEX_OP(opname, rResult, iResult, args);                 \
     return rResult + iResult * I;                                       \
   }
 
@@ -289,19 +301,105 @@ WRAP_BINARY_OPS
 WRAP_TERNARY_OPS
 #endif
 
+/*----------------------------
+====== Vector Ops ============
+----------------------------*/
+
+// Auto-vectorized loops call into libmvec, which follows the x86-64
+// vector function ABI: _ZGV<isa>N<lanes><v per arg>_<name>. The isa
+// letter decides which registers the vectors are passed in, so our
+// replacements have to be compiled for the same instruction set as
+// the functions they replace. libmvec only exists on x86-64.
+#if defined(__x86_64__)
+#define VEC_TARGET_b
+#define VEC_TARGET_c __attribute__((target("avx")))
+#define VEC_TARGET_d __attribute__((target("avx2")))
+
+typedef double hg_vec_64_2 __attribute__((vector_size(16)));
+typedef double hg_vec_64_4 __attribute__((vector_size(32)));
+typedef float hg_vec_32_4 __attribute__((vector_size(16)));
+typedef float hg_vec_32_8 __attribute__((vector_size(32)));
+
+#define WRAP_VECTOR_UNARY_(soname, prec, ctype, perform, isa, lanes,    \
+                           fnname, opname)                              \
+  VEC_TARGET_##isa hg_vec_##prec##_##lanes                              \
+  VG_REPLACE_FUNCTION_ZU(soname, fnname)(hg_vec_##prec##_##lanes x);    \
+  VEC_TARGET_##isa hg_vec_##prec##_##lanes                              \
+  VG_REPLACE_FUNCTION_ZU(soname, fnname)(hg_vec_##prec##_##lanes x){    \
+    hg_vec_##prec##_##lanes result;                                     \
+    ctype results[lanes];                                               \
+    ctype args[lanes];                                                  \
+    for(int i = 0; i < lanes; ++i){                                     \
+      args[i] = x[i];                                                   \
+    }                                                                   \
+    perform(opname, lanes, results, args, CALL_ADDR);                   \
+    for(int i = 0; i < lanes; ++i){                                     \
+      result[i] = results[i];                                           \
+    }                                                                   \
+    return result;                                                      \
+  }
+#define WRAP_VECTOR_BINARY_(soname, prec, ctype, perform, isa, lanes,   \
+                            fnname, opname)                             \
+  VEC_TARGET_##isa hg_vec_##prec##_##lanes                              \
+  VG_REPLACE_FUNCTION_ZU(soname, fnname)(hg_vec_##prec##_##lanes x,     \
+                                         hg_vec_##prec##_##lanes y);    \
+  VEC_TARGET_##isa hg_vec_##prec##_##lanes                              \
+  VG_REPLACE_FUNCTION_ZU(soname, fnname)(hg_vec_##prec##_##lanes x,     \
+                                         hg_vec_##prec##_##lanes y){    \
+    hg_vec_##prec##_##lanes result;                                     \
+    ctype results[lanes];                                               \
+    ctype args[lanes * 2];                                              \
+    for(int i = 0; i < lanes; ++i){                                     \
+      args[i * 2] = x[i];                                               \
+      args[i * 2 + 1] = y[i];                                           \
+    }                                                                   \
+    perform(opname, lanes, results, args, CALL_ADDR);                   \
+    for(int i = 0; i < lanes; ++i){                                     \
+      result[i] = results[i];                                           \
+    }                                                                   \
+    return result;                                                      \
+  }
+
+#define WRAP_VECTOR_UNARY_64(isa, lanes, fnname, opname)                \
+  WRAP_VECTOR_UNARY_(LIBMVEC, 64, double, HERBGRIND_PERFORM_VECTOR_OP_AT, \
+                     isa, lanes, fnname, opname)                        \
+  WRAP_VECTOR_UNARY_(NONE, 64, double, HERBGRIND_PERFORM_VECTOR_OP_AT,  \
+                     isa, lanes, fnname, opname)
+#define WRAP_VECTOR_UNARY_32(isa, lanes, fnname, opname)                \
+  WRAP_VECTOR_UNARY_(LIBMVEC, 32, float, HERBGRIND_PERFORM_VECTOR_OPF_AT, \
+                     isa, lanes, fnname, opname)                        \
+  WRAP_VECTOR_UNARY_(NONE, 32, float, HERBGRIND_PERFORM_VECTOR_OPF_AT,  \
+                     isa, lanes, fnname, opname)
+#define WRAP_VECTOR_BINARY_64(isa, lanes, fnname, opname)               \
+  WRAP_VECTOR_BINARY_(LIBMVEC, 64, double, HERBGRIND_PERFORM_VECTOR_OP_AT, \
+                      isa, lanes, fnname, opname)                       \
+  WRAP_VECTOR_BINARY_(NONE, 64, double, HERBGRIND_PERFORM_VECTOR_OP_AT, \
+                      isa, lanes, fnname, opname)
+#define WRAP_VECTOR_BINARY_32(isa, lanes, fnname, opname)               \
+  WRAP_VECTOR_BINARY_(LIBMVEC, 32, float, HERBGRIND_PERFORM_VECTOR_OPF_AT, \
+                      isa, lanes, fnname, opname)                       \
+  WRAP_VECTOR_BINARY_(NONE, 32, float, HERBGRIND_PERFORM_VECTOR_OPF_AT, \
+                      isa, lanes, fnname, opname)
+// This macro is defined in include/hg_mathreplace_funcs.h, and
+// invokes the above macros for each libmvec entry point we replace.
+#ifndef DONT_WRAP
+WRAP_VECTOR_OPS
+#endif
+#endif
+
 #ifndef DONT_WRAP
 // This is a special wrap
 void VG_REPLACE_FUNCTION_ZU(LIBM_CPP, sincos)(double x, double* p_sin, double* p_cos);
 void VG_REPLACE_FUNCTION_ZU(LIBM_CPP, sincos)(double x, double* p_sin, double* p_cos){
   double args[1];
   args[0] = x;
-  HERBGRIND_PERFORM_SPECIAL_OP(OP_SINCOS, args, p_sin, p_cos);
+  HERBGRIND_PERFORM_SPECIAL_OP_AT(OP_SINCOS, args, p_sin, p_cos, CALL_ADDR);
 }
 void VG_REPLACE_FUNCTION_ZU(LIBM, sincos)(double x, double* p_sin, double* p_cos);
 void VG_REPLACE_FUNCTION_ZU(LIBM, sincos)(double x, double* p_sin, double* p_cos){
   double args[1];
   args[0] = x;
-  HERBGRIND_PERFORM_SPECIAL_OP(OP_SINCOS, args, p_sin, p_cos);
+  HERBGRIND_PERFORM_SPECIAL_OP_AT(OP_SINCOS, args, p_sin, p_cos, CALL_ADDR);
 }
 
 double VG_REPLACE_FUNCTION_ZU(LIBM, modf)(double x, double* intpart);
@@ -310,7 +408,7 @@ double VG_REPLACE_FUNCTION_ZU(LIBM, modf)(double x, double* intpart){
   double fResult;
   args[0] = x;
   args[1] = 1.0;
-  HERBGRIND_PERFORM_SPECIAL_OP(OP_MODF, args, &fResult, intpart);
+  HERBGRIND_PERFORM_SPECIAL_OP_AT(OP_MODF, args, &fResult, intpart, CALL_ADDR);
   return fResult;
 }
 float VG_REPLACE_FUNCTION_ZU(LIBM, modff)(float x, float* intpart);
@@ -319,7 +417,7 @@ float VG_REPLACE_FUNCTION_ZU(LIBM, modff)(float x, float* intpart){
   float fResult;
   args[0] = x;
   args[1] = 1.0f;
-  HERBGRIND_PERFORM_SPECIAL_OP(OP_MODF, args, &fResult, intpart);
+  HERBGRIND_PERFORM_SPECIAL_OP_AT(OP_MODF, args, &fResult, intpart, CALL_ADDR);
   return fResult;
 }
 
@@ -32,8 +32,7 @@
 
 #include <stdarg.h>
 #include <stdio.h>
-#include <assert.h>
-#include <regex.h>
+#include <string.h>
 
 int uninterceptedPrintf(const char* format, ...);
 int uninterceptedPrintf(const char* format, ...){
@@ -44,75 +43,176 @@ int uninterceptedPrintf(const char* format, ...){
   return result;
 }
 
-int isFloatPrintfSpecifier(const char* str);
-int isFloatPrintfSpecifier(const char* str){
-  regex_t regex;
-  int reti;
-
-  reti = regcomp(&regex,
-                 "%[-+ #0]*[[:digit:]]*\\*\\{0,1\\}\\(\\.[[:digit:]]\\{1,\\}\\)\\{0,1\\}l\\{0,1\\}[gfeaGFEA].*",
-                 0);
-  assert(reti == 0);
-  reti = regexec(&regex, str, 0, NULL, 0);
-  regfree(&regex);
-  if (reti == 0){
-    return 1;
-  } else if (reti == REG_NOMATCH){
-    return 0;
+// Solvers like to print from inside their main loop, so we only want
+// to pick apart each format string once. We scan it by hand into a
+// list of what type each vararg is, and keep the most recent layouts
+// around keyed on the format string's address. Since a format string
+// could be built in a buffer that gets reused, each entry also keeps
+// a copy of the string to check against. Each thread gets its own
+// cache, so threads printing at the same time can't see each other's
+// half-written entries.
+#define MAX_PRINTF_ARGS 64
+#define MAX_CACHED_FORMAT_LEN 256
+#define PRINTF_LAYOUT_CACHE_SIZE 64
+
+typedef enum {
+  PA_INT,
+  PA_LONG,
+  PA_DOUBLE,
+  PA_LONG_DOUBLE,
+  PA_POINTER,
+} PrintfArgType;
+
+typedef struct {
+  const char* format;
+  char formatCopy[MAX_CACHED_FORMAT_LEN];
+  int numArgs;
+  int numFloatArgs;
+  unsigned char argTypes[MAX_PRINTF_ARGS];
+} PrintfLayout;
+
+__thread PrintfLayout printfLayoutCache[PRINTF_LAYOUT_CACHE_SIZE];
+
+void addPrintfArg(PrintfLayout* layout, PrintfArgType type);
+void addPrintfArg(PrintfLayout* layout, PrintfArgType type){
+  if (layout->numArgs == MAX_PRINTF_ARGS){
+    return;
   }
-  assert(0);
-  return 0;
-}
-int isPointerPrintfSpecifier(const char* str);
-int isPointerPrintfSpecifier(const char* str){
-  regex_t regex;
-  int reti;
-
-  reti = regcomp(&regex,
-                 "%[-+ #0]*[[:digit:]]*\\*\\{0,1\\}\\(\\.[[:digit:]]\\{1,\\}\\)\\{0,1\\}[ps].*",
-                 0);
-  assert(reti == 0);
-  reti = regexec(&regex, str, 0, NULL, 0);
-  regfree(&regex);
-  if (reti == 0){
-    return 1;
-  } else if (reti == REG_NOMATCH){
-    return 0;
+  layout->argTypes[layout->numArgs++] = type;
+  if (type == PA_DOUBLE){
+    layout->numFloatArgs += 1;
   }
-  assert(0);
-  return 0;
 }
 
-int VG_REPLACE_FUNCTION_ZU(VG_Z_LIBC_SONAME, printf)(const char* format, ...);
-int VG_REPLACE_FUNCTION_ZU(VG_Z_LIBC_SONAME, printf)(const char* format, ...){
-  va_list args;
-  va_start(args, format);
-  int numFloatArgs = 0;
+// Follows the conversion specification syntax from the printf man
+// page: %[flags][width][.precision][length]conversion, where the
+// width and precision can be a '*' that takes an int argument.
+void parsePrintfFormat(const char* format, PrintfLayout* layout);
+void parsePrintfFormat(const char* format, PrintfLayout* layout){
+  layout->numArgs = 0;
+  layout->numFloatArgs = 0;
   for (const char* p = format; *p != '\0'; p++){
+    if (*p != '%'){
+      continue;
+    }
+    p++;
     if (*p == '%'){
-      if (isFloatPrintfSpecifier(p)){
-        numFloatArgs += 1;
+      continue;
+    }
+    while (*p == '-' || *p == '+' || *p == ' ' ||
+           *p == '#' || *p == '0' || *p == '\''){
+      p++;
+    }
+    if (*p == '*'){
+      addPrintfArg(layout, PA_INT);
+      p++;
+    } else {
+      while (*p >= '0' && *p <= '9') p++;
+    }
+    if (*p == '.'){
+      p++;
+      if (*p == '*'){
+        addPrintfArg(layout, PA_INT);
+        p++;
+      } else {
+        while (*p >= '0' && *p <= '9') p++;
+      }
+    }
+    int isLong = 0;
+    int isLongDouble = 0;
+    while (*p == 'h' || *p == 'l' || *p == 'L' || *p == 'q' ||
+           *p == 'j' || *p == 'z' || *p == 't'){
+      if (*p == 'L'){
+        isLongDouble = 1;
+      } else if (*p != 'h'){
+        isLong = 1;
       }
+      p++;
+    }
+    switch(*p){
+    case 'f': case 'F':
+    case 'e': case 'E':
+    case 'g': case 'G':
+    case 'a': case 'A':
+      addPrintfArg(layout, isLongDouble ? PA_LONG_DOUBLE : PA_DOUBLE);
+      break;
+    case 'p':
+    case 's':
+    case 'n':
+      addPrintfArg(layout, PA_POINTER);
+      break;
+    case 'd': case 'i':
+    case 'o': case 'u':
+    case 'x': case 'X':
+      addPrintfArg(layout, isLong ? PA_LONG : PA_INT);
+      break;
+    case 'c':
+      addPrintfArg(layout, PA_INT);
+      break;
+    case '\0':
+      return;
+    default:
+      break;
     }
   }
+}
+
+const PrintfLayout* getPrintfLayout(const char* format,
+                                    PrintfLayout* scratch);
+const PrintfLayout* getPrintfLayout(const char* format,
+                                    PrintfLayout* scratch){
+  PrintfLayout* cached =
+    &(printfLayoutCache[((unsigned long)format >> 3) %
+                        PRINTF_LAYOUT_CACHE_SIZE]);
+  if (cached->format == format &&
+      strcmp(cached->formatCopy, format) == 0){
+    return cached;
+  }
+  if (strlen(format) >= MAX_CACHED_FORMAT_LEN){
+    parsePrintfFormat(format, scratch);
+    return scratch;
+  }
+  parsePrintfFormat(format, cached);
+  strcpy(cached->formatCopy, format);
+  cached->format = format;
+  return cached;
+}
+
+int VG_REPLACE_FUNCTION_ZU(VG_Z_LIBC_SONAME, printf)(const char* format, ...);
+int VG_REPLACE_FUNCTION_ZU(VG_Z_LIBC_SONAME, printf)(const char* format, ...){
+  va_list args;
+  va_start(args, format);
+  PrintfLayout scratch;
+  const PrintfLayout* layout = getPrintfLayout(format, &scratch);
   int fArgIdx = 0;
-  for (const char* p = format; *p != '\0'; p++){
-    if (*p == '%'){
-      if (isFloatPrintfSpecifier(p)){
+  for (int i = 0; i < layout->numArgs; ++i){
+    switch(layout->argTypes[i]){
+    case PA_DOUBLE:
+      {
         double arg = va_arg(args, double);
-        HERBGRIND_MAYBE_MARK_IMPORTANT_WITH_INDEX(arg, fArgIdx, numFloatArgs);
+        HERBGRIND_MAYBE_MARK_IMPORTANT_WITH_INDEX(arg, fArgIdx,
+                                                  layout->numFloatArgs);
         fArgIdx += 1;
-      } else if (isPointerPrintfSpecifier(p)){
-        va_arg(args, void*);
-      } else {
-        va_arg(args, int);
       }
+      break;
+    case PA_LONG_DOUBLE:
+      va_arg(args, long double);
+      break;
+    case PA_POINTER:
+      va_arg(args, void*);
+      break;
+    case PA_LONG:
+      va_arg(args, long long);
+      break;
+    default:
+      va_arg(args, int);
+      break;
     }
   }
   va_end(args);
   va_start(args, format);
-  HERBGRIND_END();
+  HERBGRIND_SUSPEND();
   int result = vprintf(format, args);
-  HERBGRIND_BEGIN();
+  HERBGRIND_RESUME();
   return result;
 }
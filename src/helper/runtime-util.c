@@ -28,6 +28,7 @@
 */
 
 #include "runtime-util.h"
+#include "symbol-cache.h"
 #include "pub_tool_stacktrace.h"
 #include "pub_tool_threadstate.h"
 #include "pub_tool_debuginfo.h"
@@ -62,11 +63,7 @@ Addr getCallAddr(void){
     // the second frame up, but screw it, this probably isn't the
     // performance bottleneck, and it might be nice to have the
     // robustness somewhere down the line.
-    const HChar* filename;
-    if (VG_(get_filename)(VG_(current_DiEpoch)(), addr, &filename)){
-      if (VG_(strcmp)(filename, "mathwrap.c") == 0) continue;
-      if (VG_(strcmp)(filename, "printf-wrap.c") == 0) continue;
-    }
+    if (getSourceInfo(addr)->inWrapper) continue;
     return addr;
   }
   return 0;
@@ -0,0 +1,162 @@
+/*--------------------------------------------------------------------*/
+/*--- Herbgrind: a valgrind tool for Herbie         symbol-cache.c ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Herbgrind, a valgrind tool for diagnosing
+   floating point accuracy problems in binary programs and extracting
+   problematic expressions.
+
+   Copyright (C) 2016-2017 Alex Sanchez-Stern
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#include "symbol-cache.h"
+#include "runtime-util.h"
+#include "pub_tool_hashtable.h"
+#include "pub_tool_mallocfree.h"
+#include "pub_tool_libcbase.h"
+
+VgHashTable* sourceInfoCache = NULL;
+
+typedef struct _internedString {
+  struct _internedString* next;
+  UWord hash;
+  const HChar* str;
+} InternedString;
+
+// Every name we've kept, so that resolving an address again after
+// the debug info changes doesn't make another copy of the same
+// names.
+VgHashTable* internedStrings = NULL;
+
+Word cmpInternedStrings(const void* node1, const void* node2);
+Word cmpInternedStrings(const void* node1, const void* node2){
+  const InternedString* entry1 = node1;
+  const InternedString* entry2 = node2;
+  return VG_(strcmp)(entry1->str, entry2->str);
+}
+
+// Returns a copy of str that lives as long as the tool does. Equal
+// strings share one copy.
+const HChar* internString(const HChar* str);
+const HChar* internString(const HChar* str){
+  if (internedStrings == NULL){
+    internedStrings = VG_(HT_construct)("interned names");
+  }
+  UWord hash = 2166136261U;
+  for(const HChar* c = str; *c != '\0'; ++c){
+    hash = (hash ^ (UChar)*c) * 16777619U;
+  }
+  InternedString key = {.hash = hash, .str = str};
+  InternedString* entry =
+    VG_(HT_gen_lookup)(internedStrings, &key, cmpInternedStrings);
+  if (entry == NULL){
+    entry = VG_(malloc)("interned name entry", sizeof(InternedString));
+    entry->hash = hash;
+    entry->str = VG_(strdup)("interned name", str);
+    VG_(HT_add_node)(internedStrings, entry);
+  }
+  return entry->str;
+}
+
+void resolveSourceInfo(SourceInfo* info);
+void resolveSourceInfo(SourceInfo* info){
+  const HChar* fnname;
+  const HChar* filename;
+  const HChar* objname;
+  UInt line;
+  info->epoch = VG_(current_DiEpoch)();
+  // The debug info hands back strings that only last until the next
+  // lookup, so copy everything we keep.
+  if (VG_(get_fnname)(info->epoch, info->addr, &fnname)){
+    info->fnname = demangleFnName(fnname);
+  } else {
+    info->fnname = "";
+  }
+  if (VG_(get_filename_linenum)(info->epoch, info->addr, &filename,
+                                NULL, &line)){
+    info->hasLine = True;
+    info->filename = internString(filename);
+    info->line = line;
+    info->inWrapper =
+      VG_(strcmp)(filename, "mathwrap.c") == 0 ||
+      VG_(strcmp)(filename, "printf-wrap.c") == 0;
+  } else {
+    info->hasLine = False;
+    info->filename = "Unknown";
+    info->line = -1;
+    info->inWrapper = False;
+  }
+  if (VG_(get_objname)(info->epoch, info->addr, &objname)){
+    info->objname = internString(objname);
+  } else {
+    info->objname = NULL;
+  }
+}
+
+SourceInfo* getSourceInfo(Addr addr){
+  if (sourceInfoCache == NULL){
+    sourceInfoCache = VG_(HT_construct)("source info cache");
+  }
+  SourceInfo* info = VG_(HT_lookup)(sourceInfoCache, addr);
+  if (info == NULL){
+    info = VG_(perm_malloc)(sizeof(SourceInfo), vg_alignof(SourceInfo));
+    info->addr = addr;
+    resolveSourceInfo(info);
+    VG_(HT_add_node)(sourceInfoCache, info);
+  } else if (info->epoch.n != VG_(current_DiEpoch)().n){
+    resolveSourceInfo(info);
+  }
+  return info;
+}
+
+// OCaml mangles its function names, so clean those up.
+const HChar* demangleFnName(const HChar* fnname){
+  if (!isPrefix("caml", fnname)){
+    return internString(fnname);
+  }
+  char* demangledFnname = VG_(malloc)("demangled name", sizeof(char) * VG_(strlen)(fnname));
+  int n = 0;
+  for(const char* p = fnname + 4; *p != '\0'; ++p){
+    if (p[0] == '_' && p[1] == '_'){
+      demangledFnname[n++] = '.';
+      p++;
+      continue;
+    }
+    if (p[0] == '_'){
+      Bool restIsTag = True;
+      for (const char* q = p + 1; *q != '\0'; ++q){
+        if (!VG_(isdigit)(*q)){
+          restIsTag = False;
+          break;
+        }
+      }
+      if (restIsTag){
+        demangledFnname[n++] = '\0';
+        break;
+      }
+    }
+    demangledFnname[n++] = *p;
+  }
+  demangledFnname[n] = '\0';
+  const HChar* result = internString(demangledFnname);
+  VG_(free)(demangledFnname);
+  return result;
+}
@@ -0,0 +1,65 @@
+/*--------------------------------------------------------------------*/
+/*--- Herbgrind: a valgrind tool for Herbie         symbol-cache.h ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Herbgrind, a valgrind tool for diagnosing
+   floating point accuracy problems in binary programs and extracting
+   problematic expressions.
+
+   Copyright (C) 2016-2017 Alex Sanchez-Stern
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+#ifndef _SYMBOL_CACHE_H
+#define _SYMBOL_CACHE_H
+
+#include "pub_tool_basics.h"
+#include "pub_tool_debuginfo.h"
+
+// Everything we print about an address. Looking these up in the
+// debug info is slow, and the same few addresses get looked up over
+// and over, both at runtime and when writing output, so we resolve
+// each address once and keep the answer. Addresses the debug info
+// doesn't know about are cached too.
+typedef struct _SourceInfo {
+  // So we can store it in a hash table.
+  struct _SourceInfo* next;
+  UWord addr;
+
+  // The debug info epoch this was resolved in. If code has been
+  // loaded or unloaded since, we look the address up again.
+  DiEpoch epoch;
+  // Demangled, and "" if unknown.
+  const HChar* fnname;
+  // These two are "Unknown" and -1 if we don't know the source line,
+  // like the output has always printed.
+  const HChar* filename;
+  UInt line;
+  Bool hasLine;
+  // NULL if unknown.
+  const HChar* objname;
+  // Whether this address is in one of our own wrapper files, which
+  // getCallAddr skips over.
+  Bool inWrapper;
+} SourceInfo;
+
+SourceInfo* getSourceInfo(Addr addr);
+const HChar* demangleFnName(const HChar* fnname);
+
+#endif
@@ -34,11 +34,17 @@
 #include "instrument/instrument.h"
 #include "runtime/shadowop/mathreplace.h"
 #include "runtime/shadowop/influence-op.h"
+#include "runtime/shadowop/error.h"
 #include "runtime/op-shadowstate/marks.h"
 #include "runtime/op-shadowstate/output.h"
+#include "runtime/op-shadowstate/snapshot.h"
+#include "runtime/value-shadowstate/value-shadowstate.h"
+#include "runtime/wrap/output-intercept.h"
 
 #include "helper/mpfr-valgrind-glue.h"
 
+#include "pub_tool_transtab.h"
+
 // This handles client requests, the macros that client programs stick
 // in to send messages to the tool.
 static Bool hg_handle_client_request(ThreadId tid, UWord* arg, UWord* ret) {
@@ -48,12 +54,25 @@ static Bool hg_handle_client_request(ThreadId tid, UWord* arg, UWord* ret) {
   switch(arg[0]) {
   case VG_USERREQ__BEGIN:
     running_depth++;
+    if (running_depth == 1 && !always_on){
+      hg_region_changed(True);
+    }
     break;
   case VG_USERREQ__END:
     running_depth--;
+    if (running_depth == 0 && !always_on){
+      hg_region_changed(False);
+    }
+    break;
+  case VG_USERREQ__SUSPEND:
+    suspend_depth++;
+    break;
+  case VG_USERREQ__RESUME:
+    suspend_depth--;
     break;
   case VG_USERREQ__PERFORM_OP:
-    performWrappedOp((OpType)arg[1], (double*)arg[2], (double*)arg[3]);
+    performWrappedOp((OpType)arg[1], (double*)arg[2], (double*)arg[3],
+                     (Addr)arg[4]);
     break;
   case VG_USERREQ__PERFORM_OPF:
     {
@@ -62,14 +81,36 @@ static Bool hg_handle_client_request(ThreadId tid, UWord* arg, UWord* ret) {
       for (int i = 0; i < getWrappedNumArgs((OpType)arg[1]); ++i){
         double_args[i] = ((float*)arg[3])[i];
       }
-      performWrappedOp((OpType)arg[1], &double_result, double_args);
+      performWrappedOp((OpType)arg[1], &double_result, double_args,
+                       (Addr)arg[4]);
       *(float*)arg[2] = double_result;
     }
     break;
   case VG_USERREQ__PERFORM_SPECIAL_OP:
     performSpecialWrappedOp((SpecialOpType)arg[1], (double*)arg[2],
-                            (double*)arg[3], (double*)arg[4]);
+                            (double*)arg[3], (double*)arg[4],
+                            (Addr)arg[5]);
     break;
+  case VG_USERREQ__PERFORM_OP_BATCH:
+    performWrappedOpBatch((HerbgrindOpRecord*)arg[1], (int)arg[2],
+                          (Addr)arg[3]);
+    break;
+  case VG_USERREQ__PERFORM_VECTOR_OP:
+    performWrappedVectorOp((OpType)arg[1], (int)arg[2],
+                           (double*)arg[3], (double*)arg[4],
+                           (Addr)arg[5]);
+    break;
+  case VG_USERREQ__PERFORM_VECTOR_OPF:
+    performWrappedVectorOpF((OpType)arg[1], (int)arg[2],
+                            (float*)arg[3], (float*)arg[4],
+                            (Addr)arg[5]);
+    break;
+  case VG_USERREQ__GET_EXACT:
+  case VG_USERREQ__GET_EXACTF:
+    *ret = getExactValues((Addr)arg[1], (double*)arg[2], (SizeT)arg[3],
+                          arg[0] == VG_USERREQ__GET_EXACTF,
+                          (HerbgrindExactFormat)arg[4]);
+    return True;
   case VG_USERREQ__MARK_IMPORTANT:
     markImportant(getMemShadow((Addr)arg[1]),
                   *(double*)(Addr)arg[1], 0, 1);
@@ -82,9 +123,22 @@ static Bool hg_handle_client_request(ThreadId tid, UWord* arg, UWord* ret) {
     maybeMarkImportant(getMemShadow((Addr)arg[1]),
                        *(double*)(Addr)arg[1], (int)arg[2], (int)arg[3]);
     break;
+  case VG_USERREQ__MARK_IMPORTANT_ARRAY:
+    markImportantArray((Addr)arg[1], (SizeT)arg[2], (SizeT)arg[3],
+                       (HerbgrindElementType)arg[4]);
+    break;
   case VG_USERREQ__FORCE_TRACK:
     forceTrack((Addr)arg[1]);
     break;
+  case VG_USERREQ__SNAPSHOT:
+    takeSnapshot();
+    break;
+  case VG_USERREQ__RESET_STATS:
+    resetStats();
+    break;
+  case VG_USERREQ__DUMP_STATS:
+    dumpStats((const HChar*)arg[1], (Bool)arg[2]);
+    break;
   default:
     return False;
   }
@@ -92,14 +146,37 @@ static Bool hg_handle_client_request(ThreadId tid, UWord* arg, UWord* ret) {
   return True;
 }
 
+// Blocks are instrumented differently inside and outside of a
+// region, so whenever we cross the boundary we throw away every
+// translation and let them be re-instrumented as they run. This
+// makes entering and leaving a region expensive, but code outside
+// of one runs with almost no overhead.
+static void hg_region_changed(Bool entering){
+  if (entering){
+    clearThreadStateShadows();
+  }
+  VG_(discard_translations_safely)((Addr)0x1000, ~(SizeT)0xfff,
+                                   "herbgrind");
+}
+
 // This is called after the program exits, for cleanup and such.
 static void hg_fini(Int exitcode){
   finish_instrumentation();
+  finishSnapshots();
   writeOutput();
+  if (print_influence_cache_stats){
+    printInfluenceCacheStats();
+  }
+  if (print_result_cache_stats){
+    printWrappedResultCacheStats();
+  }
 }
 // This does any initialization that needs to be done after command
 // line processing.
 static void hg_post_clo_init(void){
+  initErrorComputation();
+  initSnapshots();
+  initOutputSpecs();
   init_instrumentation();
 }
 
@@ -46,6 +46,9 @@ static void hg_fini(Int exitcode);
 // This handles client requests, the macros that client programs stick
 // in to send messages to the tool.
 static Bool hg_handle_client_request(ThreadId tid, UWord* arg, UWord* ret);
+// Called when the client moves in or out of a
+// HERBGRIND_BEGIN/END region.
+static void hg_region_changed(Bool entering);
 // This is where we initialize everything
 static void hg_pre_clo_init(void);
 
@@ -49,8 +49,47 @@ typedef enum {
   VG_USERREQ__MARK_IMPORTANT,
   VG_USERREQ__MAYBE_MARK_IMPORTANT,
   VG_USERREQ__MAYBE_MARK_IMPORTANT_WITH_INDEX,
+  // Replaces the snapshot file with the results so far.
+  VG_USERREQ__SNAPSHOT,
+  // Stops code translated in between from reporting spots, without
+  // starting or ending a region.
+  VG_USERREQ__SUSPEND,
+  VG_USERREQ__RESUME,
+  // Like PERFORM_OP(F), but for every lane of a vector at once.
+  VG_USERREQ__PERFORM_VECTOR_OP,
+  VG_USERREQ__PERFORM_VECTOR_OPF,
+  // Performs a whole array of HerbgrindOpRecords in one request.
+  VG_USERREQ__PERFORM_OP_BATCH,
+  // Marks every element of an array under a single mark.
+  VG_USERREQ__MARK_IMPORTANT_ARRAY,
+  // Clears the results gathered so far, or writes them to a labelled
+  // output file and then optionally clears them.
+  VG_USERREQ__RESET_STATS,
+  VG_USERREQ__DUMP_STATS,
 } Vg_HerbgrindClientRequests;
 
+// How GET_EXACT(F) writes each value: either the shadow rounded to
+// a double, or as a pair of doubles whose sum is a closer
+// approximation of the shadow.
+typedef enum {
+  HERBGRIND_EXACT_DOUBLE,
+  HERBGRIND_EXACT_DOUBLE_DOUBLE,
+} HerbgrindExactFormat;
+
+// The element types MARK_IMPORTANT_ARRAY understands.
+typedef enum {
+  HERBGRIND_DOUBLE,
+  HERBGRIND_FLOAT,
+} HerbgrindElementType;
+
+// One op for PERFORM_OP_BATCH. The arguments and result are always
+// doubles, even for single precision ops.
+typedef struct {
+  unsigned long op;
+  double* result;
+  double* args;
+} HerbgrindOpRecord;
+
 typedef enum {
   OP_SINCOS,
   OP_SINCOSF,
@@ -74,43 +113,129 @@ typedef enum {
       _qzz_res;                                   \
     }))
 
-#define HERBGRIND_PERFORM_OP(_qzz_op, _qzz_result_addr, _qzz_args)      \
+// For code that should never report spots, like the guts of printf.
+// Unlike HERBGRIND_END() and HERBGRIND_BEGIN(), these don't change
+// which code is shadowed, so they're cheap to call often.
+#define HERBGRIND_SUSPEND()                       \
+  (__extension__({unsigned long _qzz_res;         \
+      VALGRIND_DO_CLIENT_REQUEST(_qzz_res, 0,     \
+                                 VG_USERREQ__SUSPEND, \
+                                 0, 0, 0, 0, 0);  \
+      _qzz_res;                                   \
+    }))
+#define HERBGRIND_RESUME()                        \
+  (__extension__({unsigned long _qzz_res;         \
+      VALGRIND_DO_CLIENT_REQUEST(_qzz_res, 0,     \
+                                 VG_USERREQ__RESUME, \
+                                 0, 0, 0, 0, 0);  \
+      _qzz_res;                                   \
+    }))
+
+// The _AT versions take the address of the call the op should be
+// attributed to, usually a return address. Without it, the tool
+// walks the stack to find one.
+#define HERBGRIND_PERFORM_OP_AT(_qzz_op, _qzz_result_addr, _qzz_args,   \
+                                _qzz_call_addr)                         \
   (__extension__({unsigned long _qzz_res;                               \
       VALGRIND_DO_CLIENT_REQUEST(_qzz_res, 0,                           \
                                  VG_USERREQ__PERFORM_OP, \
-                                 _qzz_op, _qzz_result_addr, _qzz_args, 0, 0); \
+                                 _qzz_op, _qzz_result_addr, _qzz_args, \
+                                 _qzz_call_addr, 0);                    \
       _qzz_res; \
     }))
-#define HERBGRIND_PERFORM_OPF(_qzz_op, _qzz_result_addr, _qzz_args)      \
+#define HERBGRIND_PERFORM_OPF_AT(_qzz_op, _qzz_result_addr, _qzz_args,  \
+                                 _qzz_call_addr)                        \
   (__extension__({unsigned long _qzz_res;                               \
       VALGRIND_DO_CLIENT_REQUEST(_qzz_res, 0,                           \
                                  VG_USERREQ__PERFORM_OPF, \
-                                 _qzz_op, _qzz_result_addr, _qzz_args, 0, 0); \
+                                 _qzz_op, _qzz_result_addr, _qzz_args, \
+                                 _qzz_call_addr, 0);                    \
       _qzz_res; \
     }))
-#define HERBGRIND_PERFORM_SPECIAL_OP(_qzz_op, _qzz_args, \
-                                     _qzz_res1, _qzz_res2)              \
+#define HERBGRIND_PERFORM_SPECIAL_OP_AT(_qzz_op, _qzz_args, \
+                                        _qzz_res1, _qzz_res2,           \
+                                        _qzz_call_addr)                 \
   (__extension__({unsigned long _qzz_res;                               \
       VALGRIND_DO_CLIENT_REQUEST(_qzz_res, 0,                           \
                                  VG_USERREQ__PERFORM_SPECIAL_OP,        \
                                  _qzz_op, _qzz_args, \
-                                 _qzz_res1, _qzz_res2, 0);    \
+                                 _qzz_res1, _qzz_res2, _qzz_call_addr); \
       _qzz_res; \
     }))
+// The vector versions shadow _qzz_lanes ops in one request. The
+// results go in consecutive elements of _qzz_result_addr, and the
+// arguments for each lane are laid out one after another in
+// _qzz_args, so lane i's arguments start at _qzz_args[i * nargs].
+#define HERBGRIND_PERFORM_VECTOR_OP_AT(_qzz_op, _qzz_lanes,             \
+                                       _qzz_result_addr, _qzz_args,     \
+                                       _qzz_call_addr)                  \
+  (__extension__({unsigned long _qzz_res;                               \
+      VALGRIND_DO_CLIENT_REQUEST(_qzz_res, 0,                           \
+                                 VG_USERREQ__PERFORM_VECTOR_OP,         \
+                                 _qzz_op, _qzz_lanes,                   \
+                                 _qzz_result_addr, _qzz_args,           \
+                                 _qzz_call_addr);                       \
+      _qzz_res;                                                         \
+    }))
+#define HERBGRIND_PERFORM_VECTOR_OPF_AT(_qzz_op, _qzz_lanes,            \
+                                        _qzz_result_addr, _qzz_args,    \
+                                        _qzz_call_addr)                 \
+  (__extension__({unsigned long _qzz_res;                               \
+      VALGRIND_DO_CLIENT_REQUEST(_qzz_res, 0,                           \
+                                 VG_USERREQ__PERFORM_VECTOR_OPF,        \
+                                 _qzz_op, _qzz_lanes,                   \
+                                 _qzz_result_addr, _qzz_args,           \
+                                 _qzz_call_addr);                       \
+      _qzz_res;                                                         \
+    }))
+#define HERBGRIND_PERFORM_OP_BATCH_AT(_qzz_records, _qzz_nrecords,      \
+                                      _qzz_call_addr)                   \
+  (__extension__({unsigned long _qzz_res;                               \
+      VALGRIND_DO_CLIENT_REQUEST(_qzz_res, 0,                           \
+                                 VG_USERREQ__PERFORM_OP_BATCH,          \
+                                 _qzz_records, _qzz_nrecords,           \
+                                 _qzz_call_addr, 0, 0);                 \
+      _qzz_res;                                                         \
+    }))
+#define HERBGRIND_PERFORM_OP(_qzz_op, _qzz_result_addr, _qzz_args)      \
+  HERBGRIND_PERFORM_OP_AT(_qzz_op, _qzz_result_addr, _qzz_args, 0)
+#define HERBGRIND_PERFORM_OPF(_qzz_op, _qzz_result_addr, _qzz_args)     \
+  HERBGRIND_PERFORM_OPF_AT(_qzz_op, _qzz_result_addr, _qzz_args, 0)
+#define HERBGRIND_PERFORM_SPECIAL_OP(_qzz_op, _qzz_args, \
+                                     _qzz_res1, _qzz_res2)              \
+  HERBGRIND_PERFORM_SPECIAL_OP_AT(_qzz_op, _qzz_args,                   \
+                                  _qzz_res1, _qzz_res2, 0)
+
+#define HERBGRIND_PERFORM_OP_BATCH(_qzz_records, _qzz_nrecords)         \
+  HERBGRIND_PERFORM_OP_BATCH_AT(_qzz_records, _qzz_nrecords, 0)
+#define HERBGRIND_PERFORM_VECTOR_OP(_qzz_op, _qzz_lanes,                \
+                                    _qzz_result_addr, _qzz_args)        \
+  HERBGRIND_PERFORM_VECTOR_OP_AT(_qzz_op, _qzz_lanes,                   \
+                                 _qzz_result_addr, _qzz_args, 0)
+#define HERBGRIND_PERFORM_VECTOR_OPF(_qzz_op, _qzz_lanes,               \
+                                     _qzz_result_addr, _qzz_args)       \
+  HERBGRIND_PERFORM_VECTOR_OPF_AT(_qzz_op, _qzz_lanes,                  \
+                                  _qzz_result_addr, _qzz_args, 0)
 
-#define HERBGRIND_GET_EXACT(_qzz_varaddr)                               \
+// Copies the shadow values of the count doubles (or floats, for
+// GET_EXACTF) starting at _qzz_src into the double array _qzz_dst,
+// in the given HerbgrindExactFormat. Double-double values take two
+// slots each, high part first, so _qzz_dst needs room for 2 * count
+// doubles. Values that aren't shadowed are copied as they are.
+// Returns the number of values that were shadowed.
+#define HERBGRIND_GET_EXACT(_qzz_src, _qzz_dst, count, format)         \
   (__extension__({unsigned long _qzz_res;                               \
       VALGRIND_DO_CLIENT_REQUEST(_qzz_res, 0,                           \
                                  VG_USERREQ__GET_EXACT,                 \
-                                 _qzz_varaddr, 0, 0, 0, 0);             \
+                                 _qzz_src, _qzz_dst, count, format, 0); \
       _qzz_res;                                                         \
     }))
 
-#define HERBGRIND_GET_EXACTF(_qzz_varaddr)                              \
+#define HERBGRIND_GET_EXACTF(_qzz_src, _qzz_dst, count, format)        \
   (__extension__({unsigned long _qzz_res;                               \
       VALGRIND_DO_CLIENT_REQUEST(_qzz_res, 0,                           \
-                                 VG_USERREQ__GET_EXACT,                 \
-                                 _qzz_varaddr, 0, 0, 0, 0);             \
+                                 VG_USERREQ__GET_EXACTF,                \
+                                 _qzz_src, _qzz_dst, count, format, 0); \
       _qzz_res;                                                         \
     }))
 
@@ -151,4 +276,48 @@ typedef enum {
                                  &(_qzz_var), argIdx, nargs, 0, 0);      \
       _qzz_res;                                                 \
     }))
+// Marks count elements of the given HerbgrindElementType, starting at
+// _qzz_ptr and stride elements apart, as one mark whose error
+// statistics cover every element.
+#define HERBGRIND_MARK_IMPORTANT_ARRAY(_qzz_ptr, count, stride, type)   \
+  (__extension__({unsigned long _qzz_res;                       \
+      VALGRIND_DO_CLIENT_REQUEST(_qzz_res, 0,                   \
+                                 VG_USERREQ__MARK_IMPORTANT_ARRAY, \
+                                 _qzz_ptr, count, stride, type, 0); \
+      _qzz_res;                                                 \
+    }))
+// Starts the error and range results of every op and mark over.
+// Shadow values, and the ops that influenced them, are kept; an op
+// is only reported again once it runs after the reset.
+#define HERBGRIND_RESET_STATS()                                 \
+  (__extension__({unsigned long _qzz_res;                       \
+      VALGRIND_DO_CLIENT_REQUEST(_qzz_res, 0,                   \
+                                 VG_USERREQ__RESET_STATS,       \
+                                 0, 0, 0, 0, 0);                \
+      _qzz_res;                                                 \
+    }))
+// Writes the results so far to <outfile>.<label>, in the usual
+// output format.
+#define HERBGRIND_DUMP_STATS(_qzz_label)                        \
+  (__extension__({unsigned long _qzz_res;                       \
+      VALGRIND_DO_CLIENT_REQUEST(_qzz_res, 0,                   \
+                                 VG_USERREQ__DUMP_STATS,        \
+                                 _qzz_label, 0, 0, 0, 0);       \
+      _qzz_res;                                                 \
+    }))
+// Like DUMP_STATS, and then RESET_STATS, for per-phase reports.
+#define HERBGRIND_DUMP_AND_RESET_STATS(_qzz_label)              \
+  (__extension__({unsigned long _qzz_res;                       \
+      VALGRIND_DO_CLIENT_REQUEST(_qzz_res, 0,                   \
+                                 VG_USERREQ__DUMP_STATS,        \
+                                 _qzz_label, 1, 0, 0, 0);       \
+      _qzz_res;                                                 \
+    }))
+#define HERBGRIND_SNAPSHOT()                                    \
+  (__extension__({unsigned long _qzz_res;                       \
+      VALGRIND_DO_CLIENT_REQUEST(_qzz_res, 0,                   \
+                                 VG_USERREQ__SNAPSHOT,          \
+                                 0, 0, 0, 0, 0);                \
+      _qzz_res;                                                 \
+    }))
 #endif
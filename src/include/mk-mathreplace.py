@@ -35,8 +35,9 @@ class Op(object):
     def __init__(self, func, plain_name, nargs,
                  exact_func=None, native_func=None,
                  needsround=True, isComplex=False,
-                 precision=64):
+                 precision=64, transcendental=False):
         self.func = func
+        self.transcendental = transcendental
         self.nargs = nargs
         self.plain_name = plain_name
         self.needsround = needsround
@@ -56,7 +57,16 @@ class Op(object):
         assert self.isComplex
         return "OP_{}I".format(zEncode(self.func).upper())
 
-def write_mathreplace_funcs(ops, extra_ops, fname):
+class VectorOp(object):
+    def __init__(self, op, isa, lanes):
+        self.op = op
+        self.isa = isa
+        self.lanes = lanes
+    def symbol(self):
+        return "_ZGV{}N{}{}_{}".format(self.isa, self.lanes,
+                                       "v" * self.op.nargs, self.op.func)
+
+def write_mathreplace_funcs(ops, extra_ops, vector_ops, fname):
     with open(fname, "w") as f:
         f.write("#ifndef _MATHREPLACE_FUNCS_H\n")
         f.write("#define _MATHREPLACE_FUNCS_H\n")
@@ -189,6 +199,13 @@ def write_mathreplace_funcs(ops, extra_ops, fname):
         f.write("  TERNARY_COMPLEX_OPS_CASES_R: \\\n")
         f.write("  case TERNARY_COMPLEX_OPS_CASES_I\n")
 
+        f.write("// The real valued ops whose results generally aren't exact\n")
+        f.write("// at any precision, which are the expensive ones to shadow.\n")
+        f.write("#define TRANSCENDENTAL_OPS_CASES \\\n")
+        transcendental_ops = [op for op in ops
+                              if op.transcendental and not op.isComplex]
+        write_labels(f, transcendental_ops)
+
         f.write("// The single precision cases\n")
         f.write("#define SINGLE_CASES \\\n")
         single_ops = [op for op in ops
@@ -271,6 +288,16 @@ def write_mathreplace_funcs(ops, extra_ops, fname):
                             .format(op.precision, op.func, op.enum()))
         f.write("\n")
 
+        f.write("// Same for the libmvec entry points that auto-vectorized\n")
+        f.write("// loops call, which get all their lanes shadowed at once.\n")
+        f.write("#define WRAP_VECTOR_OPS \\\n")
+        for vop in vector_ops:
+            f.write("  WRAP_VECTOR_{}_{}({}, {}, {}, {}); \\\n"
+                    .format({1: "UNARY", 2: "BINARY"}[vop.op.nargs],
+                            vop.op.precision, vop.isa, vop.lanes,
+                            vop.symbol(), vop.op.enum()))
+        f.write("\n")
+
         f.write("// Finally, define an enum for the operations we support.\n")
         f.write("typedef enum {\n")
         f.write("  OP_INVALID,\n")
@@ -289,6 +316,7 @@ def write_mathreplace_funcs(ops, extra_ops, fname):
 
 ops = []
 extra_ops = []
+vector_ops = []
 
 def addExtraOp(name):
     extra_ops.append(name)
@@ -324,7 +352,8 @@ def addComplexOp(name, plain_name, nargs,
 
 def addOp(name, plain_name, nargs,
           hasfloat=True, needsRound=True,
-          mpfr_func=None, native_func=None):
+          mpfr_func=None, native_func=None,
+          transcendental=False):
     mpfr_fn = "mpfr_" + name
     if (mpfr_func != None):
         mpfr_fn = mpfr_func
@@ -334,35 +363,43 @@ def addOp(name, plain_name, nargs,
     ops.append(Op(name, plain_name, nargs,
                   exact_func=mpfr_fn,
                   needsround=needsRound,
-                  native_func=native_func))
+                  native_func=native_func,
+                  transcendental=transcendental))
     ops.append(Op("__"+name, plain_name, nargs,
                   exact_func=mpfr_fn,
                   needsround=needsRound,
-                  native_func=native_func))
+                  native_func=native_func,
+                  transcendental=transcendental))
     ops.append(Op("__"+name+"_avx", plain_name, nargs,
                   exact_func=mpfr_fn,
                   needsround=needsRound,
-                  native_func=native_func))
+                  native_func=native_func,
+                  transcendental=transcendental))
     ops.append(Op("__"+name+"_fma4", plain_name, nargs,
                   exact_func=mpfr_fn,
                   needsround=needsRound,
-                  native_func=native_func))
+                  native_func=native_func,
+                  transcendental=transcendental))
     ops.append(Op("__ieee754_"+name, plain_name, nargs,
                   exact_func=mpfr_fn,
                   needsround=needsRound,
-                  native_func=native_func))
+                  native_func=native_func,
+                  transcendental=transcendental))
     ops.append(Op("__ieee754_"+name+"_avx", plain_name, nargs,
                   exact_func=mpfr_fn,
                   needsround=needsRound,
-                  native_func=native_func))
+                  native_func=native_func,
+                  transcendental=transcendental))
     ops.append(Op("__ieee754_"+name+"_sse2", plain_name, nargs,
                   exact_func=mpfr_fn,
                   needsround=needsRound,
-                  native_func=native_func))
+                  native_func=native_func,
+                  transcendental=transcendental))
     ops.append(Op("__ieee754_"+name+"_fma4", plain_name, nargs,
                   exact_func=mpfr_fn,
                   needsround=needsRound,
-                  native_func=native_func))
+                  native_func=native_func,
+                  transcendental=transcendental))
 
     if hasfloat:
         if (native_func != None):
@@ -375,7 +412,23 @@ def addOp(name, plain_name, nargs,
                       exact_func=mpfr_fn,
                       needsround=needsRound,
                       precision=32,
-                      native_func=native_fn_f))
+                      native_func=native_fn_f,
+                      transcendental=transcendental))
+
+# The x86-64 vector ABI variants glibc's libmvec provides, as (isa
+# letter, double lanes). Single precision versions have twice as many
+# lanes. We leave out the AVX-512 ('e') variants, since valgrind can't
+# run AVX-512 code anyway.
+libmvec_isas = [("b", 2), ("c", 4), ("d", 4)]
+
+def addVectorOp(name):
+    scalar_ops = [op for op in ops if op.func == name or op.func == name + "f"]
+    assert len(scalar_ops) == 2
+    for op in scalar_ops:
+        for isa, lanes in libmvec_isas:
+            if op.precision == 32:
+                lanes *= 2
+            vector_ops.append(VectorOp(op, isa, lanes))
 
 def zEncode(s):
     return re.sub("_", "Zu", re.sub("Z", "ZZ", s))
@@ -504,57 +557,65 @@ addOp("floor", "floor", 1, needsRound=False)
 addOp("round", "round", 1, needsRound=False)
 addOp("trunc", "truncate", 1, needsRound=False)
 
-addOp("exp", "exponentiate", 1)
+addOp("exp", "exponentiate", 1, transcendental=True)
 addOp("__exp1", "exponentiate", 1,
-      mpfr_func="mpfr_exp", native_func="exp")
+      mpfr_func="mpfr_exp", native_func="exp",
+      transcendental=True)
 
-addOp("exp2", "base-two exponentiate", 1)
+addOp("exp2", "base-two exponentiate", 1, transcendental=True)
 addOp("exp2l", "base-two exponentiate", 1,
-      mpfr_func="mpfr_exp2", hasfloat=False)
-addOp("expm1", "exponentiate minus one", 1)
+      mpfr_func="mpfr_exp2", hasfloat=False,
+      transcendental=True)
+addOp("expm1", "exponentiate minus one", 1, transcendental=True)
 
-addOp("log", "log", 1)
+addOp("log", "log", 1, transcendental=True)
 addOp("__log_finite", "log", 1,
-      mpfr_func="mpfr_log", native_func="log")
+      mpfr_func="mpfr_log", native_func="log",
+      transcendental=True)
 
-addOp("log10", "log base ten", 1)
+addOp("log10", "log base ten", 1, transcendental=True)
 addOp("__log10_finite", "log", 1,
-      mpfr_func="mpfr_log10", native_func="log10")
-
-addOp("log1p", "plus one log", 1)
-addOp("log2", "log base two", 1)
-
-addOp("erf", "error function", 1)
-addOp("erfc", "complementary error function", 1)
-addOp("lgamma", "log gamma function", 1, mpfr_func="mpfr_lgamma2")
-addOp("tgamma", "gamma function", 1, mpfr_func="mpfr_gamma")
-addOp("j0", "order zero first kind bessel function", 1)
-addOp("j1", "order one first kind bessel function", 1)
-addOp("y0", "order zero second kind bessel function", 1)
-addOp("y1", "order one second kind bessel function", 1)
-
-addOp("cos", "cosine", 1)
-addOp("sin", "sine", 1)
-addOp("tan", "tangent", 1)
-addOp("asin", "arc sine", 1)
-addOp("acos", "arc cosine", 1)
-addOp("atan", "arc tangent", 1)
-
-addOp("sinh", "hyperbolic sine", 1)
-addOp("cosh", "hyperbolic cosine", 1)
-addOp("tanh", "hyperbolic tangent", 1)
-addOp("asinh", "hyperbolic arc sine", 1)
-addOp("acosh", "hyperbolic arc cosine", 1)
-addOp("atanh", "hyperbolic arc tangent", 1)
-
-addOp("atan2", "arc tangent (two arguments)", 2)
+      mpfr_func="mpfr_log10", native_func="log10",
+      transcendental=True)
+
+addOp("log1p", "plus one log", 1, transcendental=True)
+addOp("log2", "log base two", 1, transcendental=True)
+
+addOp("erf", "error function", 1, transcendental=True)
+addOp("erfc", "complementary error function", 1, transcendental=True)
+addOp("lgamma", "log gamma function", 1, mpfr_func="mpfr_lgamma2",
+      transcendental=True)
+addOp("tgamma", "gamma function", 1, mpfr_func="mpfr_gamma",
+      transcendental=True)
+addOp("j0", "order zero first kind bessel function", 1, transcendental=True)
+addOp("j1", "order one first kind bessel function", 1, transcendental=True)
+addOp("y0", "order zero second kind bessel function", 1, transcendental=True)
+addOp("y1", "order one second kind bessel function", 1, transcendental=True)
+
+addOp("cos", "cosine", 1, transcendental=True)
+addOp("sin", "sine", 1, transcendental=True)
+addOp("tan", "tangent", 1, transcendental=True)
+addOp("asin", "arc sine", 1, transcendental=True)
+addOp("acos", "arc cosine", 1, transcendental=True)
+addOp("atan", "arc tangent", 1, transcendental=True)
+
+addOp("sinh", "hyperbolic sine", 1, transcendental=True)
+addOp("cosh", "hyperbolic cosine", 1, transcendental=True)
+addOp("tanh", "hyperbolic tangent", 1, transcendental=True)
+addOp("asinh", "hyperbolic arc sine", 1, transcendental=True)
+addOp("acosh", "hyperbolic arc cosine", 1, transcendental=True)
+addOp("atanh", "hyperbolic arc tangent", 1, transcendental=True)
+
+addOp("atan2", "arc tangent (two arguments)", 2, transcendental=True)
 addOp("hypot", "hypotenuse", 2)
 
-addOp("pow", "power", 2)
+addOp("pow", "power", 2, transcendental=True)
 addOp("__pow_finite", "power", 2,
-      mpfr_func="mpfr_pow", native_func="pow")
+      mpfr_func="mpfr_pow", native_func="pow",
+      transcendental=True)
 addOp("slowpow", "power", 2,
-      mpfr_func="mpfr_pow", native_func="pow")
+      mpfr_func="mpfr_pow", native_func="pow",
+      transcendental=True)
 addOp("fmod", "modulus", 2)
 addOp("copysign", "copy sign", 2)
 addOp("fdim", "positive difference", 2, mpfr_func="mpfr_dim")
@@ -573,4 +634,10 @@ addComplexOp("exp", "exp", 1)
 addComplexOp("pow", "pow", 2)
 addComplexOp("fma", "fma", 3)
 
-write_mathreplace_funcs(ops, extra_ops, "mathreplace-funcs.h")
+for name in ["sin", "cos", "tan", "asin", "acos", "atan", "atan2",
+             "sinh", "cosh", "tanh", "asinh", "acosh", "atanh",
+             "exp", "exp2", "expm1", "log", "log10", "log1p", "log2",
+             "pow", "hypot", "cbrt", "erf", "erfc"]:
+    addVectorOp(name)
+
+write_mathreplace_funcs(ops, extra_ops, vector_ops, "mathreplace-funcs.h")
@@ -1194,6 +1194,66 @@ void inferTypes(IRSB* sbIn){
   }
 }
 
+int numTSTypeRecords(void){
+  int count = 0;
+  for(int i = 0; i < MAX_REGISTERS; ++i){
+    for(TSTypeEntry* entry = tsTypes[i]; entry != NULL; entry = entry->next){
+      count++;
+    }
+  }
+  return count;
+}
+void exportTypeState(int numTemps, UChar* tempTypesOut,
+                     TSTypeRecord* tsRecordsOut){
+  tl_assert(numTemps <= MAX_TEMPS);
+  for(int i = 0; i < numTemps; ++i){
+    for(int j = 0; j < MAX_TEMP_BLOCKS; ++j){
+      tempTypesOut[i * MAX_TEMP_BLOCKS + j] = tempTypes[i][j];
+    }
+  }
+  int n = 0;
+  for(int i = 0; i < MAX_REGISTERS; ++i){
+    for(TSTypeEntry* entry = tsTypes[i]; entry != NULL; entry = entry->next){
+      tsRecordsOut[n].tsAddr = i;
+      tsRecordsOut[n].instrIndexSet = entry->instrIndexSet;
+      tsRecordsOut[n].type = entry->type;
+      n++;
+    }
+  }
+}
+// This expects to be called on a fresh type state, in place of
+// inferTypes. Records for each thread state location have to be in
+// increasing instruction order, which is how exportTypeState writes
+// them.
+void importTypeState(int numTemps, const UChar* tempTypesIn,
+                     int numTSRecords, const TSTypeRecord* tsRecordsIn){
+  tl_assert(numTemps <= MAX_TEMPS);
+  for(int i = 0; i < numTemps; ++i){
+    for(int j = 0; j < MAX_TEMP_BLOCKS; ++j){
+      tempTypes[i][j] = tempTypesIn[i * MAX_TEMP_BLOCKS + j];
+    }
+  }
+  TSTypeEntry** tails[MAX_REGISTERS];
+  for(int i = 0; i < MAX_REGISTERS; ++i){
+    tails[i] = &(tsTypes[i]);
+  }
+  for(int i = 0; i < numTSRecords; ++i){
+    int tsAddr = tsRecordsIn[i].tsAddr;
+    tl_assert(tsAddr >= 0 && tsAddr < MAX_REGISTERS);
+    TSTypeEntry* newTSEntry;
+    if (stack_empty(tsTypeEntries)){
+      newTSEntry = VG_(malloc)("TSTypeEntry", sizeof(TSTypeEntry));
+    } else {
+      newTSEntry = (void*)stack_pop(tsTypeEntries);
+    }
+    newTSEntry->type = tsRecordsIn[i].type;
+    newTSEntry->instrIndexSet = tsRecordsIn[i].instrIndexSet;
+    newTSEntry->next = NULL;
+    *(tails[tsAddr]) = newTSEntry;
+    tails[tsAddr] = &(newTSEntry->next);
+  }
+}
+
 void typeJoins(ValueType* types1, ValueType* types2,
                FloatBlocks numTypes, ValueType* out){
   for(int i = 0; i < INT(numTypes); ++i){
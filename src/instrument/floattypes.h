@@ -58,6 +58,14 @@ typedef struct _TSTypeEntry {
   int instrIndexSet;
 } TSTypeEntry;
 
+// A flattened thread state type entry, used to save and restore the
+// inferred types of a block in the metadata cache.
+typedef struct _TSTypeRecord {
+  int tsAddr;
+  int instrIndexSet;
+  ValueType type;
+} TSTypeRecord;
+
 typedef struct {
   int blocks;
 } FloatBlocks;
@@ -85,6 +93,14 @@ void cleanupTypeState(void);
 void addClearMemTypes(void);
 void inferTypes(IRSB* sbIn);
 
+// Save and restore the results of inferTypes for the current
+// block. The temp types array holds MAX_TEMP_BLOCKS entries per temp.
+int numTSTypeRecords(void);
+void exportTypeState(int numTemps, UChar* tempTypesOut,
+                     TSTypeRecord* tsRecordsOut);
+void importTypeState(int numTemps, const UChar* tempTypesIn,
+                     int numTSRecords, const TSTypeRecord* tsRecordsIn);
+
 ValueType opArgPrecision(IROp op_code);
 ValueType opBlockArgPrecision(IROp op_code, int blockIdx);
 ValueType conversionArgPrecision(IROp op_code, int argIndex);
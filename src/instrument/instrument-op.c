@@ -135,7 +135,7 @@ void instrumentOp(IRSB* sbOut, IRTemp dest, IRExpr* expr,
 void handleExitFloatOp(IRSB* sbOut, IROp op_code,
                        IRExpr** argExprs, IRTemp dest,
                        Addr curAddr, Addr blockAddr){
-  if (!RUNNING) return;
+  if (!RUNNING || suspend_depth > 0) return;
   tempShadowStatus[dest] = Ss_Unshadowed;
   switch(op_code){
   case Iop_CmpF64:
@@ -45,6 +45,8 @@
 #include "../helper/instrument-util.h"
 #include "../helper/debug.h"
 #include "intercept-block.h"
+#include "metadata-cache.h"
+#include "../runtime/op-shadowstate/snapshot.h"
 
 // This is where the magic happens. This function gets called to
 // instrument every superblock.
@@ -60,16 +62,47 @@ IRSB* hg_instrument (VgCallbackClosure* closure,
     VG_(printf)("Instrumenting block at %p:\n", (void*)closure->readdr);
     printSuperBlock(sbIn);
   }
-  inferTypes(sbIn);
+  // Outside of a HERBGRIND_BEGIN/END region we don't shadow
+  // anything. The client requests that move us in and out of a
+  // region throw away every translation, so this decision is made
+  // once per block, and blocks translated here carry no shadow code
+  // at all beyond clearing the memory shadows they overwrite.
+  Bool inRegion = RUNNING || always_on;
+  if (inRegion && !restoreCachedTypes(closure->readdr, sbIn)){
+    inferTypes(sbIn);
+    cacheInferredTypes(closure->readdr, sbIn);
+  } else if (inRegion && print_inferred_types){
+    printTypeState(sbIn->tyenv);
+  }
   if (PRINT_RUN_BLOCKS){
     char* blockMessage = VG_(perm_malloc)(35, 1);
     VG_(snprintf)(blockMessage, 35,
                   "Running block at %p\n", (void*)closure->readdr);
     addPrint(blockMessage);
   }
-  IRExpr* blockStateDirtyExpr = runLoad64C(sbOut, &blockStateDirty);
-  addAssertEQ(sbOut, "Uncleaned block!\n", blockStateDirtyExpr, mkU64(0));
-  addStoreC(sbOut, mkU64(1), &blockStateDirty);
+  if (inRegion){
+    IRExpr* blockStateDirtyExpr = runLoad64C(sbOut, &blockStateDirty);
+    addAssertEQ(sbOut, "Uncleaned block!\n", blockStateDirtyExpr, mkU64(0));
+    addStoreC(sbOut, mkU64(1), &blockStateDirty);
+  }
+  if (snapshotsEnabled()){
+    IRExpr* countdown =
+      runBinop(sbOut, Iop_Sub64,
+               runLoad64C(sbOut, &snapshotCountdown), mkU64(1));
+    addStoreC(sbOut, countdown, &snapshotCountdown);
+    addStmtToIRSB(sbOut, mkDirtyG_0_N(0, "snapshotTick", snapshotTick,
+                                      mkIRExprVec_0(),
+                                      runZeroCheck64(sbOut, countdown)));
+  }
+
+  if (!inRegion){
+    for(int i = 0; i < sbIn->stmts_used; ++i){
+      IRStmt* stmt = sbIn->stmts[i];
+      addStmtToIRSB(sbOut, stmt);
+      instrumentStatementOutsideRegion(sbOut, stmt);
+    }
+    return sbOut;
+  }
 
   Addr curAddr = 0;
   Addr prevAddr = -1;
@@ -110,13 +143,20 @@ IRSB* hg_instrument (VgCallbackClosure* closure,
 
 void init_instrumentation(void){
   initInstrumentationState();
+  loadMetadataCache();
 }
 
 void finish_instrumentation(void){
   cleanupTypeState();
+  writeMetadataCache();
 }
 void preInstrumentStatement(IRSB* sbOut, IRStmt* stmt, Addr stAddr, Addr prevAddr){
   switch(stmt->tag){
+  case Ist_IMark:
+    // Check every instruction, not just the start of the block,
+    // since a block can run on into a function it calls.
+    maybeInterceptOutput(sbOut, stmt->Ist.IMark.addr);
+    break;
   case Ist_Exit:
     addBlockCleanupG(sbOut, stmt->Ist.Exit.guard);
     break;
@@ -275,6 +315,30 @@ void instrumentStatement(IRSB* sbOut, IRStmt* stmt,
   }
 }
 
+void instrumentStatementOutsideRegion(IRSB* sbOut, IRStmt* stmt){
+  if (dummy){
+    return;
+  }
+  // Memory shadows outlive the region that made them, so anything
+  // the client overwrites in the meantime has to lose its shadow,
+  // or we'd pick it back up as soon as the next region starts.
+  switch(stmt->tag){
+  case Ist_Store:
+    addClearMem(sbOut,
+                exprSize(sbOut->tyenv, stmt->Ist.Store.data),
+                stmt->Ist.Store.addr);
+    break;
+  case Ist_StoreG:
+    addClearMemG(sbOut,
+                 stmt->Ist.StoreG.details->guard,
+                 exprSize(sbOut->tyenv, stmt->Ist.StoreG.details->data),
+                 stmt->Ist.StoreG.details->addr);
+    break;
+  default:
+    break;
+  }
+}
+
 void printSuperBlock(IRSB* superblock){
   for(int i = 0; i < superblock->stmts_used; i++){
     IRStmt* st = superblock->stmts[i];
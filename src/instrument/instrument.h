@@ -44,5 +44,6 @@ void instrumentStatement(IRSB* sbOut, IRStmt* stmt,
                          Addr stAddr, Addr block_addr,
                          int stIdx, int numStmtsIn);
 void preInstrumentStatement(IRSB* sbOut, IRStmt* stmt, Addr stAddr, Addr prevAddr);
+void instrumentStatementOutsideRegion(IRSB* sbOut, IRStmt* stmt);
 
 void printSuperBlock(IRSB* superblock);
@@ -35,6 +35,7 @@
 #include "pub_tool_machine.h"
 
 #include "../runtime/wrap/printf-intercept.h"
+#include "../runtime/wrap/output-intercept.h"
 #include "../helper/instrument-util.h"
 #include "../helper/runtime-util.h"
 
@@ -45,6 +46,12 @@ const char * printfNames[] = {
   "camlPrintf__fprintf",
 };
 
+// Thread state offsets of the first few integer argument registers
+// on amd64: rdi, rsi, rdx, and rcx.
+const Int intArgOffsets[MAX_OUTPUT_INT_ARGS] = {72, 64, 32, 24};
+// And of the stack pointer, rsp.
+#define STACK_PTR_OFFSET 48
+
 void maybeInterceptBlock(IRSB* sbOut, void* blockAddr, void* srcAddr){
   const char * fnname;
   Bool isStart =
@@ -63,6 +70,26 @@ void maybeInterceptBlock(IRSB* sbOut, void* blockAddr, void* srcAddr){
   }
 }
 
+void maybeInterceptOutput(IRSB* sbOut, Addr addr){
+  const char * fnname;
+  if (!VG_(get_fnname_if_entry)(VG_(current_DiEpoch)(), addr, &fnname)){
+    return;
+  }
+  OutputSpec* spec = getOutputSpec(fnname);
+  if (spec == NULL){
+    return;
+  }
+  IRExpr* args[MAX_OUTPUT_INT_ARGS];
+  for(int i = 0; i < MAX_OUTPUT_INT_ARGS; ++i){
+    if (spec->fpArg >= 0){
+      args[i] = i == 0 ? runGet64C(sbOut, FP_ARG_OFFSET(spec->fpArg)) : mkU64(0);
+    } else {
+      args[i] = runGet64C(sbOut, intArgOffsets[i]);
+    }
+  }
+  addStmtToIRSB(sbOut, IRStmt_Dirty(unsafeIRDirty_0_N(6, "interceptOutput", VG_(fnptr_to_fnentry)(interceptOutput), mkIRExprVec_6(mkU64((uintptr_t)spec), runGet64C(sbOut, STACK_PTR_OFFSET), args[0], args[1], args[2], args[3]))));
+}
+
 /* ------------------------------------------
 
    The thread state location TS(72), as far as I can tell, contains a
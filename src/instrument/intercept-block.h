@@ -33,5 +33,8 @@
 #include "pub_tool_tooliface.h"
 
 void maybeInterceptBlock(IRSB* sbOut, void* blockAddr, void* srcAddr);
+// If addr is the start of a function with an output spec, adds a
+// call to interceptOutput.
+void maybeInterceptOutput(IRSB* sbOut, Addr addr);
 
 #endif
@@ -0,0 +1,467 @@
+/*--------------------------------------------------------------------*/
+/*--- Herbgrind: a valgrind tool for Herbie       metadata-cache.c ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Herbgrind, a valgrind tool for diagnosing
+   floating point accuracy problems in binary programs and extracting
+   problematic expressions.
+
+   Copyright (C) 2016-2017 Alex Sanchez-Stern
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#include "metadata-cache.h"
+#include "../options.h"
+#include "../helper/ir-info.h"
+
+#include "pub_tool_vki.h"
+#include "pub_tool_libcbase.h"
+#include "pub_tool_libcfile.h"
+#include "pub_tool_libcprint.h"
+#include "pub_tool_libcassert.h"
+#include "pub_tool_mallocfree.h"
+#include "pub_tool_debuginfo.h"
+#include "pub_tool_hashtable.h"
+#include "pub_tool_xarray.h"
+
+#define METADATA_CACHE_MAGIC 0x43474D48
+#define METADATA_CACHE_VERSION 1
+#define METADATA_WRITE_BUFFER_SIZE 65536
+
+XArray* cachedObjects = NULL;
+VgHashTable* blockTypesMap = NULL;
+// Set whenever the in-memory cache differs from what we loaded, so
+// that runs which hit entirely in the cache don't rewrite it.
+Bool metadataCacheDirty = False;
+
+long int cmpBlockTypesEntry(const void* node1, const void* node2){
+  const BlockTypesEntry* entry1 = (const BlockTypesEntry*)node1;
+  const BlockTypesEntry* entry2 = (const BlockTypesEntry*)node2;
+  return !(entry1->offset == entry2->offset &&
+           entry1->objIdx == entry2->objIdx);
+}
+
+// Figure out which object file a block came from, and its offset
+// within it. Returns -1 if the block isn't in an object file we can
+// identify, in which case we won't cache anything about it.
+int lookupCachedObject(Addr addr, UWord* offsetOut){
+  DebugInfo* di = VG_(find_DebugInfo)(VG_(current_DiEpoch)(), addr);
+  if (di == NULL){
+    return -1;
+  }
+  const HChar* path = VG_(DebugInfo_get_filename)(di);
+  *offsetOut = addr - VG_(DebugInfo_get_text_avma)(di);
+  for(int i = 0; i < VG_(sizeXA)(cachedObjects); ++i){
+    CachedObject* obj = VG_(indexXA)(cachedObjects, i);
+    if (obj->stale || VG_(strcmp)(obj->path, path) != 0){
+      continue;
+    }
+    if (!obj->checked){
+      // The first time we see an object from the cache file this run,
+      // make sure it's still the same file we cached it from. If it
+      // isn't, all the records under it are useless, so we start a
+      // new entry for it.
+      struct vg_stat statBuf;
+      SysRes statResult = VG_(stat)(path, &statBuf);
+      obj->checked = True;
+      if (sr_isError(statResult) ||
+          statBuf.size != obj->size ||
+          statBuf.mtime != obj->mtime){
+        obj->stale = True;
+        metadataCacheDirty = True;
+        break;
+      }
+    }
+    return i;
+  }
+  struct vg_stat statBuf;
+  if (sr_isError(VG_(stat)(path, &statBuf))){
+    return -1;
+  }
+  CachedObject newObj = {
+    .path = VG_(strdup)("cached object path", path),
+    .size = statBuf.size,
+    .mtime = statBuf.mtime,
+    .checked = True,
+    .stale = False,
+  };
+  return VG_(addToXA)(cachedObjects, &newObj);
+}
+
+// A cheap structural hash of a block, so that we don't restore types
+// into a block that VEX translated differently than the one we
+// cached (for instance, because of different valgrind options). This
+// deliberately avoids absolute addresses.
+UInt blockFingerprint(IRSB* sbIn){
+  UInt hash = 2166136261u;
+#define MIX(x) hash = (hash ^ (UInt)(x)) * 16777619u
+  MIX(sbIn->stmts_used);
+  MIX(sbIn->tyenv->types_used);
+  for(int i = 0; i < sbIn->tyenv->types_used; ++i){
+    MIX(sbIn->tyenv->types[i]);
+  }
+  for(int i = 0; i < sbIn->stmts_used; ++i){
+    IRStmt* stmt = sbIn->stmts[i];
+    MIX(stmt->tag);
+    switch(stmt->tag){
+    case Ist_IMark:
+      MIX(stmt->Ist.IMark.len);
+      break;
+    case Ist_Put:
+      MIX(stmt->Ist.Put.offset);
+      break;
+    case Ist_WrTmp:{
+      IRExpr* data = stmt->Ist.WrTmp.data;
+      MIX(data->tag);
+      switch(data->tag){
+      case Iex_Get:
+        MIX(data->Iex.Get.offset);
+        break;
+      case Iex_Unop:
+        MIX(data->Iex.Unop.op);
+        break;
+      case Iex_Binop:
+        MIX(data->Iex.Binop.op);
+        break;
+      case Iex_Triop:
+        MIX(data->Iex.Triop.details->op);
+        break;
+      case Iex_Qop:
+        MIX(data->Iex.Qop.details->op);
+        break;
+      default:
+        break;
+      }
+    }
+      break;
+    default:
+      break;
+    }
+  }
+#undef MIX
+  return hash;
+}
+
+BlockTypesEntry* lookupBlockTypes(Addr blockAddr){
+  UWord offset;
+  int objIdx = lookupCachedObject(blockAddr, &offset);
+  if (objIdx < 0){
+    return NULL;
+  }
+  BlockTypesEntry key = {.offset = offset, .objIdx = objIdx};
+  return VG_(HT_gen_lookup)(blockTypesMap, &key, cmpBlockTypesEntry);
+}
+
+Bool restoreCachedTypes(Addr blockAddr, IRSB* sbIn){
+  if (metadata_cache_filename == NULL){
+    return False;
+  }
+  BlockTypesEntry* entry = lookupBlockTypes(blockAddr);
+  if (entry == NULL ||
+      entry->numTemps != sbIn->tyenv->types_used ||
+      entry->fingerprint != blockFingerprint(sbIn)){
+    return False;
+  }
+  importTypeState(entry->numTemps, entry->tempTypes,
+                  entry->numTSRecords, entry->tsRecords);
+  return True;
+}
+
+void cacheInferredTypes(Addr blockAddr, IRSB* sbIn){
+  if (metadata_cache_filename == NULL ||
+      sbIn->tyenv->types_used > MAX_TEMPS){
+    return;
+  }
+  UWord offset;
+  int objIdx = lookupCachedObject(blockAddr, &offset);
+  if (objIdx < 0){
+    return;
+  }
+  BlockTypesEntry key = {.offset = offset, .objIdx = objIdx};
+  BlockTypesEntry* entry =
+    VG_(HT_gen_lookup)(blockTypesMap, &key, cmpBlockTypesEntry);
+  if (entry == NULL){
+    entry = VG_(malloc)("block types entry", sizeof(BlockTypesEntry));
+    entry->offset = offset;
+    entry->objIdx = objIdx;
+    VG_(HT_add_node)(blockTypesMap, entry);
+  } else {
+    VG_(free)(entry->tempTypes);
+    VG_(free)(entry->tsRecords);
+  }
+  entry->fingerprint = blockFingerprint(sbIn);
+  entry->numTemps = sbIn->tyenv->types_used;
+  entry->numTSRecords = numTSTypeRecords();
+  entry->tempTypes =
+    VG_(malloc)("block temp types",
+                entry->numTemps * MAX_TEMP_BLOCKS * sizeof(UChar) + 1);
+  entry->tsRecords =
+    VG_(malloc)("block ts types",
+                entry->numTSRecords * sizeof(TSTypeRecord) + 1);
+  exportTypeState(entry->numTemps, entry->tempTypes, entry->tsRecords);
+  metadataCacheDirty = True;
+}
+
+void freeBlockTypesEntry(void* node){
+  BlockTypesEntry* entry = node;
+  VG_(free)(entry->tempTypes);
+  VG_(free)(entry->tsRecords);
+  VG_(free)(entry);
+}
+
+void resetMetadataCache(void){
+  if (cachedObjects != NULL){
+    for(int i = 0; i < VG_(sizeXA)(cachedObjects); ++i){
+      VG_(free)(((CachedObject*)VG_(indexXA)(cachedObjects, i))->path);
+    }
+    VG_(deleteXA)(cachedObjects);
+  }
+  if (blockTypesMap != NULL){
+    VG_(HT_destruct)(blockTypesMap, freeBlockTypesEntry);
+  }
+  cachedObjects = VG_(newXA)(VG_(malloc), "cached objects",
+                             VG_(free), sizeof(CachedObject));
+  blockTypesMap = VG_(HT_construct)("block types map");
+}
+
+typedef struct _CacheReader {
+  const UChar* pos;
+  const UChar* end;
+} CacheReader;
+
+Bool readCacheBytes(CacheReader* reader, void* out, SizeT size){
+  if (reader->end - reader->pos < size){
+    return False;
+  }
+  VG_(memcpy)(out, reader->pos, size);
+  reader->pos += size;
+  return True;
+}
+
+Bool parseMetadataCache(CacheReader* reader){
+  UInt magic, version, maxTempBlocks, numObjects, numBlocks;
+  if (!readCacheBytes(reader, &magic, sizeof(magic)) ||
+      !readCacheBytes(reader, &version, sizeof(version)) ||
+      !readCacheBytes(reader, &maxTempBlocks, sizeof(maxTempBlocks)) ||
+      magic != METADATA_CACHE_MAGIC ||
+      version != METADATA_CACHE_VERSION ||
+      maxTempBlocks != MAX_TEMP_BLOCKS){
+    return False;
+  }
+  if (!readCacheBytes(reader, &numObjects, sizeof(numObjects))){
+    return False;
+  }
+  for(int i = 0; i < numObjects; ++i){
+    UInt pathLen;
+    CachedObject obj = {.checked = False, .stale = False};
+    if (!readCacheBytes(reader, &pathLen, sizeof(pathLen)) ||
+        reader->end - reader->pos < pathLen){
+      return False;
+    }
+    obj.path = VG_(malloc)("cached object path", pathLen + 1);
+    readCacheBytes(reader, obj.path, pathLen);
+    obj.path[pathLen] = '\0';
+    if (!readCacheBytes(reader, &(obj.size), sizeof(obj.size)) ||
+        !readCacheBytes(reader, &(obj.mtime), sizeof(obj.mtime))){
+      VG_(free)(obj.path);
+      return False;
+    }
+    VG_(addToXA)(cachedObjects, &obj);
+  }
+  if (!readCacheBytes(reader, &numBlocks, sizeof(numBlocks))){
+    return False;
+  }
+  for(int i = 0; i < numBlocks; ++i){
+    UInt objIdx, fingerprint, numTemps, numTSRecords;
+    UWord offset;
+    if (!readCacheBytes(reader, &objIdx, sizeof(objIdx)) ||
+        !readCacheBytes(reader, &offset, sizeof(offset)) ||
+        !readCacheBytes(reader, &fingerprint, sizeof(fingerprint)) ||
+        !readCacheBytes(reader, &numTemps, sizeof(numTemps)) ||
+        !readCacheBytes(reader, &numTSRecords, sizeof(numTSRecords)) ||
+        objIdx >= numObjects || numTemps > MAX_TEMPS){
+      return False;
+    }
+    SizeT tempTypesSize = numTemps * MAX_TEMP_BLOCKS * sizeof(UChar);
+    SizeT tsRecordsSize = (SizeT)numTSRecords * sizeof(TSTypeRecord);
+    if (reader->end - reader->pos < tempTypesSize + tsRecordsSize){
+      return False;
+    }
+    BlockTypesEntry* entry =
+      VG_(malloc)("block types entry", sizeof(BlockTypesEntry));
+    entry->offset = offset;
+    entry->objIdx = objIdx;
+    entry->fingerprint = fingerprint;
+    entry->numTemps = numTemps;
+    entry->numTSRecords = numTSRecords;
+    entry->tempTypes = VG_(malloc)("block temp types", tempTypesSize + 1);
+    entry->tsRecords = VG_(malloc)("block ts types", tsRecordsSize + 1);
+    readCacheBytes(reader, entry->tempTypes, tempTypesSize);
+    readCacheBytes(reader, entry->tsRecords, tsRecordsSize);
+    VG_(HT_add_node)(blockTypesMap, entry);
+    for(int j = 0; j < numTemps * MAX_TEMP_BLOCKS; ++j){
+      if (entry->tempTypes[j] > Vt_SingleOrNonFloat){
+        return False;
+      }
+    }
+    for(int j = 0; j < numTSRecords; ++j){
+      if (entry->tsRecords[j].tsAddr < 0 ||
+          entry->tsRecords[j].tsAddr >= MAX_REGISTERS ||
+          entry->tsRecords[j].type > Vt_SingleOrNonFloat){
+        return False;
+      }
+    }
+  }
+  return reader->pos == reader->end;
+}
+
+void loadMetadataCache(void){
+  resetMetadataCache();
+  if (metadata_cache_filename == NULL){
+    return;
+  }
+  SysRes fileResult = VG_(open)(metadata_cache_filename, VKI_O_RDONLY, 0);
+  if (sr_isError(fileResult)){
+    // Nothing cached yet, we'll create the file at exit.
+    return;
+  }
+  Int fileD = sr_Res(fileResult);
+  struct vg_stat statBuf;
+  if (VG_(fstat)(fileD, &statBuf) != 0 || statBuf.size == 0){
+    VG_(close)(fileD);
+    return;
+  }
+  UChar* contents = VG_(malloc)("metadata cache contents", statBuf.size);
+  Int bytesRead = VG_(read)(fileD, contents, statBuf.size);
+  VG_(close)(fileD);
+  CacheReader reader = {.pos = contents, .end = contents + bytesRead};
+  if (bytesRead != statBuf.size || !parseMetadataCache(&reader)){
+    VG_(umsg)("Ignoring malformed metadata cache %s\n",
+              metadata_cache_filename);
+    resetMetadataCache();
+    metadataCacheDirty = True;
+  }
+  VG_(free)(contents);
+}
+
+typedef struct _CacheWriter {
+  Int fileD;
+  SizeT used;
+  UChar buffer[METADATA_WRITE_BUFFER_SIZE];
+} CacheWriter;
+
+void flushCacheWriter(CacheWriter* writer){
+  VG_(write)(writer->fileD, writer->buffer, writer->used);
+  writer->used = 0;
+}
+void writeCacheBytes(CacheWriter* writer, const void* data, SizeT size){
+  const UChar* bytes = data;
+  while(size > 0){
+    if (writer->used == METADATA_WRITE_BUFFER_SIZE){
+      flushCacheWriter(writer);
+    }
+    SizeT chunk = METADATA_WRITE_BUFFER_SIZE - writer->used;
+    if (chunk > size){
+      chunk = size;
+    }
+    VG_(memcpy)(writer->buffer + writer->used, bytes, chunk);
+    writer->used += chunk;
+    bytes += chunk;
+    size -= chunk;
+  }
+}
+
+void writeMetadataCache(void){
+  if (metadata_cache_filename == NULL || !metadataCacheDirty){
+    return;
+  }
+  SysRes fileResult =
+    VG_(open)(metadata_cache_filename,
+              VKI_O_CREAT | VKI_O_TRUNC | VKI_O_WRONLY,
+              VKI_S_IRUSR | VKI_S_IWUSR);
+  if (sr_isError(fileResult)){
+    VG_(umsg)("Couldn't open metadata cache %s for writing!\n",
+              metadata_cache_filename);
+    return;
+  }
+  CacheWriter* writer = VG_(malloc)("metadata cache writer",
+                                    sizeof(CacheWriter));
+  writer->fileD = sr_Res(fileResult);
+  writer->used = 0;
+
+  // Stale objects get dropped along with their blocks, so renumber
+  // the ones we're keeping.
+  int numObjects = VG_(sizeXA)(cachedObjects);
+  int* newObjIdxs = VG_(malloc)("object renumbering",
+                                sizeof(int) * (numObjects + 1));
+  UInt numLiveObjects = 0;
+  for(int i = 0; i < numObjects; ++i){
+    CachedObject* obj = VG_(indexXA)(cachedObjects, i);
+    newObjIdxs[i] = obj->stale ? -1 : numLiveObjects++;
+  }
+  UInt header[] = {METADATA_CACHE_MAGIC, METADATA_CACHE_VERSION,
+                   MAX_TEMP_BLOCKS, numLiveObjects};
+  writeCacheBytes(writer, header, sizeof(header));
+  for(int i = 0; i < numObjects; ++i){
+    CachedObject* obj = VG_(indexXA)(cachedObjects, i);
+    if (obj->stale){
+      continue;
+    }
+    UInt pathLen = VG_(strlen)(obj->path);
+    writeCacheBytes(writer, &pathLen, sizeof(pathLen));
+    writeCacheBytes(writer, obj->path, pathLen);
+    writeCacheBytes(writer, &(obj->size), sizeof(obj->size));
+    writeCacheBytes(writer, &(obj->mtime), sizeof(obj->mtime));
+  }
+
+  UInt numLiveBlocks = 0;
+  VG_(HT_ResetIter)(blockTypesMap);
+  for(BlockTypesEntry* entry = VG_(HT_Next)(blockTypesMap);
+      entry != NULL; entry = VG_(HT_Next)(blockTypesMap)){
+    if (newObjIdxs[entry->objIdx] >= 0){
+      numLiveBlocks++;
+    }
+  }
+  writeCacheBytes(writer, &numLiveBlocks, sizeof(numLiveBlocks));
+  VG_(HT_ResetIter)(blockTypesMap);
+  for(BlockTypesEntry* entry = VG_(HT_Next)(blockTypesMap);
+      entry != NULL; entry = VG_(HT_Next)(blockTypesMap)){
+    if (newObjIdxs[entry->objIdx] < 0){
+      continue;
+    }
+    UInt objIdx = newObjIdxs[entry->objIdx];
+    UInt numTemps = entry->numTemps;
+    UInt numTSRecords = entry->numTSRecords;
+    writeCacheBytes(writer, &objIdx, sizeof(objIdx));
+    writeCacheBytes(writer, &(entry->offset), sizeof(entry->offset));
+    writeCacheBytes(writer, &(entry->fingerprint), sizeof(entry->fingerprint));
+    writeCacheBytes(writer, &numTemps, sizeof(numTemps));
+    writeCacheBytes(writer, &numTSRecords, sizeof(numTSRecords));
+    writeCacheBytes(writer, entry->tempTypes,
+                    numTemps * MAX_TEMP_BLOCKS * sizeof(UChar));
+    writeCacheBytes(writer, entry->tsRecords,
+                    numTSRecords * sizeof(TSTypeRecord));
+  }
+  flushCacheWriter(writer);
+  VG_(close)(writer->fileD);
+  VG_(free)(writer);
+  VG_(free)(newObjIdxs);
+  metadataCacheDirty = False;
+}
@@ -0,0 +1,76 @@
+/*--------------------------------------------------------------------*/
+/*--- Herbgrind: a valgrind tool for Herbie       metadata-cache.h ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Herbgrind, a valgrind tool for diagnosing
+   floating point accuracy problems in binary programs and extracting
+   problematic expressions.
+
+   Copyright (C) 2016-2017 Alex Sanchez-Stern
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+#ifndef _METADATA_CACHE_H
+#define _METADATA_CACHE_H
+
+#include "pub_tool_basics.h"
+#include "pub_tool_tooliface.h"
+
+#include "floattypes.h"
+
+// An on-disk cache of per-block instrumentation metadata, so that
+// repeated runs of the same binary don't have to redo type inference
+// for every block they translate. Blocks are keyed by the object file
+// they come from (path, size and modification time) and their offset
+// from the start of its text segment, so the cache survives address
+// space randomization.
+
+typedef struct _CachedObject {
+  HChar* path;
+  Long size;
+  ULong mtime;
+  // Whether we've compared this entry against the file on disk yet
+  // this run, and if so whether it still matches.
+  Bool checked;
+  Bool stale;
+} CachedObject;
+
+typedef struct _BlockTypesEntry {
+  struct _BlockTypesEntry* next;
+  UWord offset;
+  int objIdx;
+  UInt fingerprint;
+  int numTemps;
+  UChar* tempTypes;
+  int numTSRecords;
+  TSTypeRecord* tsRecords;
+} BlockTypesEntry;
+
+void loadMetadataCache(void);
+void writeMetadataCache(void);
+
+// Restores the inferred types for the block at blockAddr into the
+// type state, if we have a valid record for it. Returns True if it
+// did, False if the caller needs to run inference itself.
+Bool restoreCachedTypes(Addr blockAddr, IRSB* sbIn);
+// Records the current type state as the inferred types for the block
+// at blockAddr.
+void cacheInferredTypes(Addr blockAddr, IRSB* sbIn);
+
+#endif
@@ -36,6 +36,7 @@
 #include "mpfr.h"
 
 int running_depth = 1;
+int suspend_depth = 0;
 Bool always_on = False;
 
 Bool print_in_blocks = False;
@@ -63,6 +64,8 @@ Bool print_type_inference = False;
 Bool print_inferred_types = False;
 Bool print_statement_numbers = False;
 Bool print_bit_twiddles = False;
+Bool print_influence_cache_stats = False;
+Bool print_result_cache_stats = False;
 Int longprint_len = 15;
 
 Bool dont_ignore_pure_zeroes = False;
@@ -71,7 +74,10 @@ Bool print_object_files = False;
 Bool print_subexpr_locations = False;
 Bool output_mark_exprs = False;
 Bool detailed_ranges = False;
+Bool input_histograms = False;
+Bool error_quantiles = False;
 Bool output_sexp = False;
+Bool output_binary = False;
 Bool fpcore_ranges = True;
 Bool sound_simplify = True;
 Bool shortmark_all_exprs = False;
@@ -93,10 +99,14 @@ Bool use_ranges = True;
 Bool dummy = False;
 
 Int precision = 1000;
+Int transcendental_precision = 0;
 Int max_expr_block_depth = 5;
 double error_threshold = 5.0;
 Int max_influences = 20;
 const char* output_filename = NULL;
+const char* metadata_cache_filename = NULL;
+const char* snapshot_interval_arg = NULL;
+const char* output_spec_filename = NULL;
 
 // Called to process each command line option.
 Bool hg_process_cmd_line_option(const HChar* arg){
@@ -125,6 +135,8 @@ Bool hg_process_cmd_line_option(const HChar* arg){
   else if VG_XACT_CLO(arg, "--print-inferred-types", print_inferred_types, True) {}
   else if VG_XACT_CLO(arg, "--print-statement-numbers", print_statement_numbers, True) {}
   else if VG_XACT_CLO(arg, "--print-bit-twiddles", print_bit_twiddles, True) {}
+  else if VG_XACT_CLO(arg, "--print-influence-cache-stats", print_influence_cache_stats, True) {}
+  else if VG_XACT_CLO(arg, "--print-result-cache-stats", print_result_cache_stats, True) {}
   else if VG_XACT_CLO(arg, "--output-subexpr-sources", print_subexpr_locations, True) {}
   else if VG_XACT_CLO(arg, "--dont-ignore-pure-zeroes", dont_ignore_pure_zeroes, True) {}
   else if VG_XACT_CLO(arg, "--no-sound-simplify", sound_simplify, False) {}
@@ -137,11 +149,14 @@ Bool hg_process_cmd_line_option(const HChar* arg){
   else if VG_XACT_CLO(arg, "--expr-colors", expr_colors, True) {}
   else if VG_XACT_CLO(arg, "--output-mark-exprs", output_mark_exprs, True) {}
   else if VG_XACT_CLO(arg, "--detailed-ranges", detailed_ranges, True) {}
+  else if VG_XACT_CLO(arg, "--input-histograms", input_histograms, True) {}
+  else if VG_XACT_CLO(arg, "--error-quantiles", error_quantiles, True) {}
   else if VG_XACT_CLO(arg, "--shortmark-all-exprs", shortmark_all_exprs, True) {}
   else if VG_XACT_CLO(arg, "--only-improvable", only_improvable, True) {}
   else if VG_XACT_CLO(arg, "--start-off", running_depth, 0) {}
   else if VG_XACT_CLO(arg, "--always-on", always_on, True) {}
   else if VG_XACT_CLO(arg, "--output-sexp", output_sexp, True) {}
+  else if VG_XACT_CLO(arg, "--output-binary", output_binary, True) {}
   else if VG_XACT_CLO(arg, "--no-fpcore-ranges", fpcore_ranges, False) {}
   else if VG_XACT_CLO(arg, "--no-mark-on-escape", mark_on_escape, False) {}
   else if VG_XACT_CLO(arg, "--no-compensation-detection", compensation_detection, False)
@@ -155,10 +170,15 @@ Bool hg_process_cmd_line_option(const HChar* arg){
 
   else if VG_BINT_CLO(arg, "--longprint-len", longprint_len, 1, 1000) {}
   else if VG_BINT_CLO(arg, "--precision", precision, MPFR_PREC_MIN, MPFR_PREC_MAX){}
+  else if VG_BINT_CLO(arg, "--transcendental-precision", transcendental_precision,
+                      MPFR_PREC_MIN, MPFR_PREC_MAX){}
   else if VG_BINT_CLO(arg, "--max-expr-block-depth", max_expr_block_depth, 1, 100) {}
   else if VG_DBL_CLO(arg, "--error-threshold", error_threshold) {}
   else if VG_BINT_CLO(arg, "--max-influences", max_influences, 1, 1000) {}
   else if VG_STR_CLO(arg, "--outfile", output_filename) {}
+  else if VG_STR_CLO(arg, "--metadata-cache", metadata_cache_filename) {}
+  else if VG_STR_CLO(arg, "--snapshot-interval", snapshot_interval_arg) {}
+  else if VG_STR_CLO(arg, "--output-spec", output_spec_filename) {}
   else return False;
   return True;
 }
@@ -166,6 +186,9 @@ Bool hg_process_cmd_line_option(const HChar* arg){
 void hg_print_usage(void){
   VG_(printf)("    --precision=value    "
               "Sets the mantissa size of the shadow \"real\" values. [1000]\n"
+              "    --transcendental-precision=value    "
+              "Evaluates wrapped transcendental functions like exp and "
+              "sin to this many bits instead. [same as --precision]\n"
               "    --error-threshold=bits    "
               "The number of bits of error at which to start "
               "tracking a computation. [5.0]\n"
@@ -175,8 +198,28 @@ void hg_print_usage(void){
               "    --outfile=name    "
               "The name of the file to write out. If no name is "
               "specified, will use <executable-name>.gh.\n"
+              "    --metadata-cache=name    "
+              "Cache per-block instrumentation metadata in this file, "
+              "so later runs of the same binaries can skip type "
+              "inference for blocks they've already seen.\n"
+              "    --snapshot-interval=<seconds>|<blocks>b    "
+              "Every so often, write the results so far over "
+              "<outfile>.snapshot, in the "
+              "--output-binary format, so long runs that get killed "
+              "still leave results behind. Snapshots can also be "
+              "taken with HERBGRIND_SNAPSHOT().\n"
+              "    --output-spec=name    "
+              "Read extra functions that write floating point data "
+              "out of the program from this file, one per line, like "
+              "\"fwrite buf=0 size=1 count=2\". See "
+              "runtime/wrap/output-intercept.h for the format.\n"
               "    --output-sexp    "
               "Output in an easy-to-parse s-expression based format.\n"
+              "    --output-binary    "
+              "Output in a compact binary format, which is faster to "
+              "write for big reports. Use ghb-convert.py to turn it "
+              "into the text or s-expression format. If no outfile is "
+              "specified, will use <executable-name>.ghb.\n"
               "    --output-subexpr-sources    "
               "Print the source locations of every subexpression that "
               "isn't in the same function as its parent.\n"
@@ -193,6 +236,12 @@ void hg_print_usage(void){
               "Print the full expressions for marks.\n"
               "    --detailed-ranges     "
               "Print more detailed information about the input ranges.\n"
+              "    --input-histograms     "
+              "Keep a histogram of the magnitudes of each operation's "
+              "inputs, and print it alongside the input ranges.\n"
+              "    --error-quantiles     "
+              "Print the 50th, 90th and 99th percentile error of each "
+              "mark and influence, alongside the average and max.\n"
               "    --no-sound-simplify    "
               "Don't simplify expressions in simple ways which don't affect "
               "their floating point behavior.\n"
@@ -250,11 +299,18 @@ void hg_print_debug_usage(void){
               "Print's the object file name along other debug "
               "info when printing addresses.\n"
               " --start-off "
-              "Start's the analysis with the running flag set to off\n"
+              "Start's the analysis with the running flag set to off, so only\n"
+              "    code between HERBGRIND_BEGIN() and HERBGRIND_END() is shadowed\n"
               " --always-on "
               "Ignore calls to HERBGRIND_END()\n"
               " --longprint-len=length "
               "How many digits of long real values to print.\n"
               " --print-flagged "
-              "Print every operation that is flagged.\n");
+              "Print every operation that is flagged.\n"
+              " --print-influence-cache-stats "
+              "Print hit and miss counts for the influence merge "
+              "cache at exit.\n"
+              " --print-result-cache-stats "
+              "Print hit and miss counts for the wrapped math "
+              "result cache at exit.\n");
 }
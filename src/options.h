@@ -33,6 +33,7 @@
 #include "pub_tool_basics.h"
 
 extern int running_depth;
+extern int suspend_depth;
 extern Bool always_on;
 
 // Options for printing the VEX blocks that pass through
@@ -64,6 +65,8 @@ extern Bool print_type_inference;
 extern Bool print_inferred_types;
 extern Bool print_statement_numbers;
 extern Bool print_bit_twiddles;
+extern Bool print_influence_cache_stats;
+extern Bool print_result_cache_stats;
 extern Int longprint_len;
 
 extern Bool dont_ignore_pure_zeroes;
@@ -72,7 +75,10 @@ extern Bool print_object_files;
 extern Bool print_subexpr_locations;
 extern Bool output_mark_exprs;
 extern Bool detailed_ranges;
+extern Bool input_histograms;
+extern Bool error_quantiles;
 extern Bool output_sexp;
+extern Bool output_binary;
 extern Bool fpcore_ranges;
 extern Bool sound_simplify;
 extern Bool shortmark_all_exprs;
@@ -94,10 +100,14 @@ extern Bool use_ranges;
 extern Bool dummy;
 
 extern Int precision;
+extern Int transcendental_precision;
 extern Int max_expr_block_depth;
 extern double error_threshold;
 extern Int max_influences;
 extern const char* output_filename;
+extern const char* metadata_cache_filename;
+extern const char* snapshot_interval_arg;
+extern const char* output_spec_filename;
 
 #define USE_MPFR
 
@@ -0,0 +1,583 @@
+/*--------------------------------------------------------------------*/
+/*--- Herbgrind: a valgrind tool for Herbie        binary-output.c ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Herbgrind, a valgrind tool for diagnosing
+   floating point accuracy problems in binary programs and extracting
+   problematic expressions.
+
+   Copyright (C) 2016-2017 Alex Sanchez-Stern
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#include "binary-output.h"
+#include "output.h"
+#include "marks.h"
+#include "shadowop-info.h"
+#include "pub_tool_libcprint.h"
+#include "pub_tool_libcfile.h"
+#include "pub_tool_libcbase.h"
+#include "pub_tool_libcassert.h"
+#include "pub_tool_debuginfo.h"
+#include "pub_tool_hashtable.h"
+#include "pub_tool_mallocfree.h"
+#include "../../options.h"
+#include "../value-shadowstate/exprs.h"
+#include "../shadowop/symbolic-op.h"
+#include "../../helper/ir-info.h"
+#include "../../helper/runtime-util.h"
+#include "../../helper/symbol-cache.h"
+
+typedef struct _ghbStringEntry {
+  struct _ghbStringEntry* next;
+  UWord hash;
+  HChar* str;
+  UInt id;
+} GhbStringEntry;
+
+typedef struct _ghbLocation {
+  UInt fnname;
+  UInt filename;
+  UInt line;
+  UInt objname;
+} GhbLocation;
+
+// The writer that the functions below write to.
+GhbWriter* ghbWriter = NULL;
+
+void ghbFlush(void);
+void ghbFlush(void){
+  if (ghbWriter->used > 0){
+    VG_(write)(ghbWriter->fileD, ghbWriter->buf, ghbWriter->used);
+    ghbWriter->used = 0;
+  }
+}
+void ghbWriteBytes(const void* data, SizeT len);
+void ghbWriteBytes(const void* data, SizeT len){
+  const char* bytes = data;
+  while(len > 0){
+    if (ghbWriter->used == GHB_BUFFER_SIZE){
+      ghbFlush();
+    }
+    SizeT chunk = GHB_BUFFER_SIZE - ghbWriter->used;
+    if (chunk > len){
+      chunk = len;
+    }
+    VG_(memcpy)(ghbWriter->buf + ghbWriter->used, bytes, chunk);
+    ghbWriter->used += chunk;
+    bytes += chunk;
+    len -= chunk;
+  }
+}
+void ghbWriteU8(UChar val);
+void ghbWriteU8(UChar val){
+  ghbWriteBytes(&val, sizeof(val));
+}
+void ghbWriteU32(UInt val);
+void ghbWriteU32(UInt val){
+  ghbWriteBytes(&val, sizeof(val));
+}
+void ghbWriteU64(ULong val);
+void ghbWriteU64(ULong val){
+  ghbWriteBytes(&val, sizeof(val));
+}
+void ghbWriteF64(double val);
+void ghbWriteF64(double val){
+  ghbWriteBytes(&val, sizeof(val));
+}
+
+Word cmpGhbStrings(const void* node1, const void* node2);
+Word cmpGhbStrings(const void* node1, const void* node2){
+  const GhbStringEntry* entry1 = node1;
+  const GhbStringEntry* entry2 = node2;
+  return VG_(strcmp)(entry1->str, entry2->str);
+}
+
+// Returns the id of the given string, writing a string record for it
+// if this is the first time we've seen it. Since this can write a
+// record, don't call it in the middle of writing another one.
+UInt ghbString(const HChar* str);
+UInt ghbString(const HChar* str){
+  UWord hash = 2166136261U;
+  for(const HChar* c = str; *c != '\0'; ++c){
+    hash = (hash ^ (UChar)*c) * 16777619U;
+  }
+  GhbStringEntry key = {.hash = hash, .str = (HChar*)str};
+  GhbStringEntry* entry =
+    VG_(HT_gen_lookup)(ghbWriter->strings, &key, cmpGhbStrings);
+  if (entry != NULL){
+    return entry->id;
+  }
+  entry = VG_(malloc)("ghb string entry", sizeof(GhbStringEntry));
+  entry->hash = hash;
+  entry->str = VG_(strdup)("ghb string", str);
+  entry->id = ghbWriter->nextStringId++;
+  VG_(HT_add_node)(ghbWriter->strings, entry);
+
+  UInt len = VG_(strlen)(str);
+  ghbWriteU8(GHB_TAG_STRING);
+  ghbWriteU32(entry->id);
+  ghbWriteU32(len);
+  ghbWriteBytes(str, len);
+  return entry->id;
+}
+
+void freeGhbString(void* node);
+void freeGhbString(void* node){
+  GhbStringEntry* entry = node;
+  VG_(free)(entry->str);
+  VG_(free)(entry);
+}
+
+void ghbGetLocation(Addr addr, GhbLocation* loc);
+void ghbGetLocation(Addr addr, GhbLocation* loc){
+  SourceInfo* info = getSourceInfo(addr);
+  loc->filename = ghbString(info->filename);
+  loc->line = info->line;
+  loc->fnname = ghbString(info->fnname);
+  loc->objname = ghbString(info->objname == NULL ?
+                           "Unknown Object" : info->objname);
+}
+void ghbWriteLocation(GhbLocation* loc);
+void ghbWriteLocation(GhbLocation* loc){
+  ghbWriteU32(loc->fnname);
+  ghbWriteU32(loc->filename);
+  ghbWriteU32(loc->line);
+  ghbWriteU32(loc->objname);
+}
+
+void ghbWriteErrorStats(ErrorAggregate* eagg);
+void ghbWriteErrorStats(ErrorAggregate* eagg){
+  ghbWriteF64(eagg->max_error);
+  ghbWriteF64(eagg->total_error);
+  ghbWriteU64(eagg->num_evals);
+  ghbWriteBytes(eagg->error_bins, sizeof(eagg->error_bins));
+}
+
+void ghbWriteRange(RangeRecord* range);
+void ghbWriteRange(RangeRecord* range){
+  ghbWriteF64(range->pos_range.min);
+  ghbWriteF64(range->pos_range.max);
+  ghbWriteF64(range->neg_range.min);
+  ghbWriteF64(range->neg_range.max);
+}
+
+UInt ghbWriteConstNode(double value);
+UInt ghbWriteConstNode(double value){
+  UInt id = ghbWriter->nextNodeId++;
+  ghbWriteU8(GHB_TAG_EXPR_NODE);
+  ghbWriteU32(id);
+  ghbWriteU8(GHB_NODE_CONST);
+  ghbWriteF64(value);
+  return id;
+}
+UInt ghbWriteOpNode(const HChar* sym, Addr addr, int nargs, UInt* args);
+UInt ghbWriteOpNode(const HChar* sym, Addr addr, int nargs, UInt* args){
+  UInt symId = ghbString(sym);
+  UInt id = ghbWriter->nextNodeId++;
+  ghbWriteU8(GHB_TAG_EXPR_NODE);
+  ghbWriteU32(id);
+  ghbWriteU8(GHB_NODE_OP);
+  ghbWriteU32(symId);
+  ghbWriteU64(addr);
+  ghbWriteU32(nargs);
+  for(int i = 0; i < nargs; ++i){
+    ghbWriteU32(args[i]);
+  }
+  return id;
+}
+
+// Writes the nodes of the expression below curPos, children first,
+// and returns the id of the top one. This makes the same
+// simplifications as the string printer in exprs.c when
+// sound_simplify is on, so both outputs show the same expressions.
+UInt ghbWriteExprNodes(SymbExpr* expr, VarMap* varMap,
+                       NodePos curPos, int maxDepth);
+UInt ghbWriteExprNodes(SymbExpr* expr, VarMap* varMap,
+                       NodePos curPos, int maxDepth){
+  if (maxDepth == 0 || expr->type == Node_Leaf){
+    if (expr->isConst){
+      return ghbWriteConstNode(expr->constVal);
+    }
+    UInt id = ghbWriter->nextNodeId++;
+    ghbWriteU8(GHB_TAG_EXPR_NODE);
+    ghbWriteU32(id);
+    ghbWriteU8(GHB_NODE_VAR);
+    ghbWriteU32(lookupVar(varMap, curPos));
+    return id;
+  }
+  if (sound_simplify){
+    switch((int)expr->branch.op->op_code){
+    case Iop_Mul32F0x4:
+    case Iop_Mul64F0x2:
+    case Iop_Mul32Fx8:
+    case Iop_Mul64Fx4:
+    case Iop_Mul32Fx4:
+    case Iop_Mul64Fx2:
+    case Iop_MulF64:
+    case Iop_MulF128:
+    case Iop_MulF32:
+    case Iop_MulF64r32:
+      {
+        SymbExpr* arg0 = expr->branch.args[0];
+        SymbExpr* arg1 = expr->branch.args[1];
+        tl_assert(expr->branch.nargs > 1);
+        if (arg0->isConst && arg0->constVal == 1.0){
+          return ghbWriteExprNodes(arg1, varMap, rconsPos(curPos, 1),
+                                   maxDepth - 1);
+        }
+        if (arg1->isConst && arg1->constVal == 1.0){
+          return ghbWriteExprNodes(arg0, varMap, rconsPos(curPos, 0),
+                                   maxDepth - 1);
+        }
+        if ((arg0->isConst && arg0->constVal == 0.0) ||
+            (arg1->isConst && arg1->constVal == 0.0)){
+          return ghbWriteConstNode(0.0);
+        }
+        break;
+      }
+    case Iop_Add32Fx2:
+    case Iop_Add32F0x4:
+    case Iop_Add64F0x2:
+    case Iop_Add32Fx8:
+    case Iop_Add64Fx4:
+    case Iop_Add32Fx4:
+    case Iop_Add64Fx2:
+    case Iop_AddF128:
+    case Iop_AddF64:
+    case Iop_AddF32:
+    case Iop_AddF64r32:
+      {
+        SymbExpr* arg0 = expr->branch.args[0];
+        SymbExpr* arg1 = expr->branch.args[1];
+        tl_assert(expr->branch.nargs > 1);
+        if (arg0->isConst && arg0->constVal == 0.0){
+          return ghbWriteExprNodes(arg1, varMap, rconsPos(curPos, 1),
+                                   maxDepth - 1);
+        }
+        if (arg1->isConst && arg1->constVal == 0.0){
+          return ghbWriteExprNodes(arg0, varMap, rconsPos(curPos, 0),
+                                   maxDepth - 1);
+        }
+        break;
+      }
+    case Iop_Sub32Fx2:
+    case Iop_Sub32F0x4:
+    case Iop_Sub64F0x2:
+    case Iop_Sub32Fx8:
+    case Iop_Sub64Fx4:
+    case Iop_Sub32Fx4:
+    case Iop_Sub64Fx2:
+    case Iop_SubF128:
+    case Iop_SubF64:
+    case Iop_SubF32:
+    case Iop_SubF64r32:
+      {
+        SymbExpr* arg0 = expr->branch.args[0];
+        SymbExpr* arg1 = expr->branch.args[1];
+        tl_assert(expr->branch.nargs > 1);
+        if (arg0->isConst && arg0->constVal == 0.0){
+          UInt negated = ghbWriteExprNodes(arg1, varMap, rconsPos(curPos, 1),
+                                           maxDepth - 1);
+          return ghbWriteOpNode("-", expr->branch.op->op_addr, 1, &negated);
+        }
+        if (arg1->isConst && arg1->constVal == 0.0){
+          return ghbWriteExprNodes(arg0, varMap, rconsPos(curPos, 0),
+                                   maxDepth - 1);
+        }
+        break;
+      }
+    default:
+      break;
+    }
+  }
+  UInt args[MAX_BRANCH_ARGS];
+  tl_assert(expr->branch.nargs <= MAX_BRANCH_ARGS);
+  for(int i = 0; i < expr->branch.nargs; ++i){
+    args[i] = ghbWriteExprNodes(expr->branch.args[i], varMap,
+                                rconsPos(curPos, i), maxDepth - 1);
+  }
+  return ghbWriteOpNode(opSym(expr->branch.op), expr->branch.op->op_addr,
+                        expr->branch.nargs, args);
+}
+
+// Writes out a whole expression, and returns the id of its root
+// node, or zero if we're not tracking expressions.
+UInt ghbWriteExpr(SymbExpr* expr, int* numVarsOut);
+UInt ghbWriteExpr(SymbExpr* expr, int* numVarsOut){
+  *numVarsOut = 0;
+  if (no_exprs || expr == NULL){
+    return 0;
+  }
+  if (expr->type == Node_Leaf){
+    if (expr->isConst){
+      return ghbWriteConstNode(expr->constVal);
+    }
+    UInt id = ghbWriter->nextNodeId++;
+    ghbWriteU8(GHB_TAG_EXPR_NODE);
+    ghbWriteU32(id);
+    ghbWriteU8(GHB_NODE_VAR);
+    ghbWriteU32(0);
+    *numVarsOut = 1;
+    return id;
+  }
+  VarMap* varMap =
+    mkVarMap(groupsWithoutNonVars(expr, expr->branch.groups,
+                                  max_expr_block_depth));
+  UInt root = ghbWriteExprNodes(expr, varMap, null_pos, max_expr_block_depth);
+  *numVarsOut = countVars(varMap);
+  freeVarMap(varMap);
+  return root;
+}
+
+Bool ghbOpWritten(ShadowOpInfo* opinfo);
+Bool ghbOpWritten(ShadowOpInfo* opinfo){
+  tl_assert(opinfo->influence_id >= 0 &&
+            opinfo->influence_id < numInfluenceIds);
+  return opinfo->influence_id < ghbWriter->writtenOpsSize &&
+    ghbWriter->writtenOps[opinfo->influence_id];
+}
+
+// Most bins are empty, so only write the ones that aren't.
+void ghbWriteInputHistogram(InputHistogram* histogram);
+void ghbWriteInputHistogram(InputHistogram* histogram){
+  UInt numNonEmpty = 0;
+  for(int i = 0; i < INPUT_HISTOGRAM_BINS; ++i){
+    if (histogram->counts[i] != 0){
+      numNonEmpty += 1;
+    }
+  }
+  ghbWriteU32(numNonEmpty);
+  for(int i = 0; i < INPUT_HISTOGRAM_BINS; ++i){
+    if (histogram->counts[i] != 0){
+      ghbWriteU32(i);
+      ghbWriteU32(histogram->counts[i]);
+    }
+  }
+}
+
+void ghbWriteOp(ShadowOpInfo* opinfo);
+void ghbWriteOp(ShadowOpInfo* opinfo){
+  if (opinfo->influence_id >= ghbWriter->writtenOpsSize){
+    int newSize = numInfluenceIds * 2;
+    ghbWriter->writtenOps =
+      VG_(realloc)("ghb written ops", ghbWriter->writtenOps,
+                   newSize * sizeof(Bool));
+    VG_(memset)(ghbWriter->writtenOps + ghbWriter->writtenOpsSize, 0,
+                (newSize - ghbWriter->writtenOpsSize) * sizeof(Bool));
+    ghbWriter->writtenOpsSize = newSize;
+  }
+  ghbWriter->writtenOps[opinfo->influence_id] = True;
+
+  GhbLocation loc;
+  ghbGetLocation(opinfo->op_addr, &loc);
+  int numVars = 0;
+  UInt root = 0;
+  RangeRecord* totalRanges = NULL;
+  RangeRecord* problematicRanges = NULL;
+  double* exampleProblematicArgs = NULL;
+  if (!no_exprs){
+    SymbExpr* expr = getOutputExpr(opinfo);
+    root = ghbWriteExpr(expr, &numVars);
+    getRangesAndExample(&totalRanges, &problematicRanges,
+                        &exampleProblematicArgs,
+                        expr, numVars);
+    freeSwallowedExpr(expr);
+  }
+
+  ghbWriteU8(GHB_TAG_OP);
+  ghbWriteU32(opinfo->influence_id);
+  ghbWriteU64(opinfo->op_addr);
+  ghbWriteLocation(&loc);
+  ghbWriteErrorStats(&(opinfo->agg.global_error));
+  ghbWriteErrorStats(&(opinfo->agg.local_error));
+  ghbWriteU32(root);
+  if (totalRanges == NULL){
+    numVars = 0;
+  }
+  ghbWriteU32(numVars);
+  for(int i = 0; i < numVars; ++i){
+    ghbWriteRange(&(totalRanges[i]));
+    ghbWriteRange(&(problematicRanges[i]));
+    ghbWriteF64(exampleProblematicArgs[i]);
+    if (totalRanges[i].histogram != NULL){
+      ghbWriteU8(1);
+      ghbWriteInputHistogram(totalRanges[i].histogram);
+    } else {
+      ghbWriteU8(0);
+    }
+  }
+  if (totalRanges != NULL){
+    VG_(free)(totalRanges);
+    VG_(free)(problematicRanges);
+    VG_(free)(exampleProblematicArgs);
+  }
+}
+
+// Writes the ops that a mark will refer to, and returns them in a
+// freshly allocated array for ghbWriteInfluenceIds.
+int ghbWriteInfluenceOps(InfluenceList influences,
+                         ShadowOpInfo*** rankedOut);
+int ghbWriteInfluenceOps(InfluenceList influences,
+                         ShadowOpInfo*** rankedOut){
+  InfluenceList filtered = reportedInfluences(influences);
+  *rankedOut = NULL;
+  if (filtered == NULL){
+    return 0;
+  }
+  int numRanked = rankInfluences(filtered, rankedOut);
+  disownInfluenceList(filtered);
+  for(int i = 0; i < numRanked; ++i){
+    if (!ghbOpWritten((*rankedOut)[i])){
+      ghbWriteOp((*rankedOut)[i]);
+    }
+  }
+  return numRanked;
+}
+void ghbWriteInfluenceIds(ShadowOpInfo** ranked, int numRanked);
+void ghbWriteInfluenceIds(ShadowOpInfo** ranked, int numRanked){
+  ghbWriteU32(numRanked);
+  for(int i = 0; i < numRanked; ++i){
+    ghbWriteU32(ranked[i]->influence_id);
+  }
+  if (ranked != NULL){
+    VG_(free)(ranked);
+  }
+}
+
+GhbWriter* mkGhbWriter(Int fileD){
+  GhbWriter* writer = VG_(malloc)("ghb writer", sizeof(GhbWriter));
+  writer->fileD = fileD;
+  writer->used = 0;
+  writer->strings = VG_(HT_construct)("ghb strings");
+  writer->nextStringId = 0;
+  writer->nextNodeId = 1;
+  writer->writtenOps = NULL;
+  writer->writtenOpsSize = 0;
+
+  ghbWriter = writer;
+  ghbWriteBytes(GHB_MAGIC, 4);
+  ghbWriteU32(GHB_VERSION);
+  ghbWriteU8((detailed_ranges ? GHB_FLAG_DETAILED_RANGES : 0) |
+             (use_ranges ? GHB_FLAG_USE_RANGES : 0) |
+             (fpcore_ranges ? GHB_FLAG_FPCORE_RANGES : 0) |
+             (flip_ranges ? GHB_FLAG_FLIP_RANGES : 0) |
+             (no_exprs ? GHB_FLAG_NO_EXPRS : 0) |
+             (error_quantiles ? GHB_FLAG_ERROR_QUANTILES : 0));
+  return writer;
+}
+
+void freeGhbWriter(GhbWriter* writer){
+  ghbWriter = writer;
+  ghbFlush();
+  ghbWriter = NULL;
+  if (writer->writtenOps != NULL){
+    VG_(free)(writer->writtenOps);
+  }
+  VG_(HT_destruct)(writer->strings, freeGhbString);
+  VG_(free)(writer);
+}
+
+void ghbWriteMark(MarkInfo* markInfo, int argIdx, int nmarks);
+void ghbWriteMark(MarkInfo* markInfo, int argIdx, int nmarks){
+  ShadowOpInfo** ranked;
+  int numRanked = ghbWriteInfluenceOps(markInfo->influences, &ranked);
+  int numVars;
+  UInt root = 0;
+  if (output_mark_exprs){
+    root = ghbWriteExpr(markInfo->expr, &numVars);
+  }
+  GhbLocation loc;
+  ghbGetLocation(markInfo->addr, &loc);
+
+  ghbWriteU8(GHB_TAG_MARK);
+  ghbWriteU64(markInfo->addr);
+  ghbWriteU32(argIdx);
+  ghbWriteU32(nmarks);
+  ghbWriteLocation(&loc);
+  ghbWriteErrorStats(&(markInfo->eagg));
+  ghbWriteU32(root);
+  ghbWriteInfluenceIds(ranked, numRanked);
+}
+
+void ghbWriteIntMark(IntMarkInfo* intMarkInfo);
+void ghbWriteIntMark(IntMarkInfo* intMarkInfo){
+  ShadowOpInfo** ranked;
+  int numRanked = ghbWriteInfluenceOps(intMarkInfo->influences, &ranked);
+  UInt roots[2] = {0, 0};
+  tl_assert(intMarkInfo->nargs <= 2);
+  if (output_mark_exprs){
+    for(int i = 0; i < intMarkInfo->nargs; ++i){
+      int numVars;
+      roots[i] = ghbWriteExpr(intMarkInfo->exprs[i], &numVars);
+    }
+  }
+  UInt markType = ghbString(intMarkInfo->markType);
+  GhbLocation loc;
+  ghbGetLocation(intMarkInfo->addr, &loc);
+
+  ghbWriteU8(GHB_TAG_INT_MARK);
+  ghbWriteU32(markType);
+  ghbWriteU64(intMarkInfo->addr);
+  ghbWriteLocation(&loc);
+  ghbWriteU64(intMarkInfo->num_hits);
+  ghbWriteU64(intMarkInfo->num_mismatches);
+  ghbWriteU32(intMarkInfo->nargs);
+  for(int i = 0; i < intMarkInfo->nargs; ++i){
+    ghbWriteU32(roots[i]);
+  }
+  ghbWriteInfluenceIds(ranked, numRanked);
+}
+
+void ghbWriteResults(void);
+void ghbWriteResults(void){
+  VG_(HT_ResetIter)(markMap);
+  for(MarkInfoArray* markInfoArray = VG_(HT_Next)(markMap);
+      markInfoArray != NULL; markInfoArray = VG_(HT_Next)(markMap)){
+    for(int argIdx = 0; argIdx < markInfoArray->nmarks; ++argIdx){
+      MarkInfo* markInfo = &(markInfoArray->marks[argIdx]);
+      if (markInfo->eagg.num_evals == 0){
+        continue;
+      }
+      ghbWriteMark(markInfo, argIdx, markInfoArray->nmarks);
+    }
+  }
+
+  VG_(HT_ResetIter)(intMarkMap);
+  for(IntMarkInfo* intMarkInfo = VG_(HT_Next)(intMarkMap);
+      intMarkInfo != NULL; intMarkInfo = VG_(HT_Next)(intMarkMap)){
+    if (intMarkInfo->num_mismatches == 0) continue;
+    ghbWriteIntMark(intMarkInfo);
+  }
+}
+
+void writeBinaryOutput(Int fileD){
+  GhbWriter* writer = mkGhbWriter(fileD);
+  ghbWriteResults();
+  freeGhbWriter(writer);
+}
+
+void writeBinarySnapshot(Int fileD, UInt snapshotNum){
+  GhbWriter* writer = mkGhbWriter(fileD);
+  ghbWriteResults();
+  ghbWriteU8(GHB_TAG_CHECKPOINT);
+  ghbWriteU32(snapshotNum);
+  freeGhbWriter(writer);
+}
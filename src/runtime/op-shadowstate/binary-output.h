@@ -0,0 +1,125 @@
+/*--------------------------------------------------------------------*/
+/*--- Herbgrind: a valgrind tool for Herbie        binary-output.h ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Herbgrind, a valgrind tool for diagnosing
+   floating point accuracy problems in binary programs and extracting
+   problematic expressions.
+
+   Copyright (C) 2016-2017 Alex Sanchez-Stern
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+#ifndef _BINARY_OUTPUT_H
+#define _BINARY_OUTPUT_H
+
+#include "pub_tool_basics.h"
+#include "pub_tool_hashtable.h"
+
+// The .ghb format, written with --output-binary and turned back into
+// the usual text or sexp output by ghb-convert.py.
+//
+// The file starts with the four bytes "GHB1", a u32 format version,
+// and a u8 of flags (GHB_FLAG_*). After that it's a stream of
+// records, each a u8 tag followed by its fields. All numbers are
+// native endian and unaligned. Records only refer to strings, ops and
+// expression nodes that have already appeared, so the converter can
+// read the file in one pass:
+//
+//   'S' string:  u32 id, u32 length, the bytes (no terminator).
+//   'E' expr node: u32 id (ids start at 1, 0 means no expression),
+//       u8 kind, then for GHB_NODE_CONST an f64, for GHB_NODE_VAR a
+//       u32 variable index, and for GHB_NODE_OP a u32 symbol string,
+//       a u64 op address, a u32 argument count, and the argument
+//       node ids.
+//   'O' op: u32 op id, u64 address, u32 function, file and object
+//       strings with a u32 line number between the file and the
+//       object, global then local error stats, a u32 root node, a
+//       u32 variable count, then per variable the total range, the
+//       problematic range, an f64 example input, and a u8 saying
+//       whether an input histogram for the variable follows.
+//   'M' mark: u64 address, u32 argument index, u32 number of
+//       arguments, function, file, line and object as for ops, error
+//       stats, a u32 root node, a u32 influence count and the op ids.
+//   'I' int mark: u32 mark type string, u64 address, function, file,
+//       line and object as for ops, i64 hits, i64 mismatches, a u32
+//       argument count and a root node for each, a u32 influence
+//       count and the op ids.
+//   'C' checkpoint: u32 snapshot number. Snapshot files end with
+//       one, so a reader can tell a complete snapshot from a cut off
+//       one.
+//
+// A later op, mark or int mark record for the same op id, address
+// and argument, or mark type and address replaces the earlier one.
+//
+// Error stats are f64 max, f64 total, i64 evaluations, and then
+// ERROR_HISTOGRAM_BINS u64 counts. A range is four f64s: positive min
+// and max, then negative min and max. A histogram is a u32 number
+// of non-empty bins, then for each a u32 bin index and a u32 count.
+
+#define GHB_MAGIC "GHB1"
+#define GHB_VERSION 3
+
+#define GHB_FLAG_DETAILED_RANGES 0x1
+#define GHB_FLAG_USE_RANGES 0x2
+#define GHB_FLAG_FPCORE_RANGES 0x4
+#define GHB_FLAG_FLIP_RANGES 0x8
+#define GHB_FLAG_NO_EXPRS 0x10
+#define GHB_FLAG_ERROR_QUANTILES 0x20
+
+#define GHB_TAG_STRING 'S'
+#define GHB_TAG_EXPR_NODE 'E'
+#define GHB_TAG_OP 'O'
+#define GHB_TAG_MARK 'M'
+#define GHB_TAG_INT_MARK 'I'
+#define GHB_TAG_CHECKPOINT 'C'
+
+#define GHB_NODE_CONST 0
+#define GHB_NODE_VAR 1
+#define GHB_NODE_OP 2
+
+// Output goes through a buffer of this size, which is flushed when
+// full, so there's no limit on how big one entry can be.
+#define GHB_BUFFER_SIZE 65536
+
+typedef struct _ghbWriter {
+  Int fileD;
+  // Strings we've already written, so we can refer to them by id.
+  VgHashTable* strings;
+  UInt nextStringId;
+  UInt nextNodeId;
+  // Indexed by influence id, so each op is only written once per
+  // file no matter how many marks it influences.
+  Bool* writtenOps;
+  int writtenOpsSize;
+  int used;
+  char buf[GHB_BUFFER_SIZE];
+} GhbWriter;
+
+// Makes a writer for the given file, and writes the file header.
+GhbWriter* mkGhbWriter(Int fileD);
+// Flushes and frees the writer, but doesn't close the file.
+void freeGhbWriter(GhbWriter* writer);
+
+// Writes out all the results.
+void writeBinaryOutput(Int fileD);
+// Writes out all the results so far, then a checkpoint.
+void writeBinarySnapshot(Int fileD, UInt snapshotNum);
+
+#endif
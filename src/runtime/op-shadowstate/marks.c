@@ -30,6 +30,7 @@
 #include "marks.h"
 #include "../../helper/runtime-util.h"
 #include "../value-shadowstate/shadowval.h"
+#include "../value-shadowstate/value-shadowstate.h"
 #include "../shadowop/error.h"
 #include "../shadowop/influence-op.h"
 #include "../shadowop/symbolic-op.h"
@@ -48,9 +49,12 @@ void maybeMarkImportantAtAddr(ShadowValue* val, double clientValue,
   if (no_influences) return;
   if (val == NULL) return;
   MarkInfo* info = getMarkInfo(callAddr, argIdx, nargs);
-  double thisError =
+  updateMarkInfo(info, val, clientValue);
+}
+void updateMarkInfo(MarkInfo* info, ShadowValue* val, double clientValue){
+  ULong thisError =
     updateError(&(info->eagg), val->real, clientValue);
-  if (thisError >= error_threshold){
+  if (thisError >= error_threshold_ulps){
     inPlaceMergeInfluences(&(info->influences), val->influences);
   }
   if (!no_exprs && output_mark_exprs){
@@ -58,6 +62,37 @@ void maybeMarkImportantAtAddr(ShadowValue* val, double clientValue,
     generalizeSymbolicExpr(&(info->expr), val->expr);
   }
 }
+typedef struct _OutputBufferMark {
+  MarkInfo* info;
+  Addr end;
+} OutputBufferMark;
+
+void markOutputBufferValue(Addr addr, ShadowValue* val, void* closure);
+void markOutputBufferValue(Addr addr, ShadowValue* val, void* closure){
+  OutputBufferMark* mark = closure;
+  if (val->type == Vt_Single){
+    updateMarkInfo(mark->info, val, *(float*)addr);
+  } else if (mark->end - addr >= sizeof(double)){
+    updateMarkInfo(mark->info, val, *(double*)addr);
+  }
+}
+void markOutputBuffer(Addr callAddr, Addr buf, SizeT len){
+  if (no_influences) return;
+  if (len == 0) return;
+  OutputBufferMark mark = {.info = getMarkInfo(callAddr, 0, 1),
+                           .end = buf + len};
+  forEachMemShadow(buf, len, markOutputBufferValue, &mark);
+}
+// Values without a shadow are counted as exact evaluations.
+void addUnshadowedEvals(MarkInfo* info, long long int count);
+void addUnshadowedEvals(MarkInfo* info, long long int count){
+  if (count == 0) return;
+  if (info->eagg.max_error < 0){
+    info->eagg.max_error = 0;
+  }
+  info->eagg.num_evals += count;
+  info->eagg.error_bins[0] += count;
+}
 void markImportant(ShadowValue* val, double clientValue, int argIdx, int nargs){
   if (no_influences){
     return;
@@ -66,20 +101,86 @@ void markImportant(ShadowValue* val, double clientValue, int argIdx, int nargs){
   MarkInfo* info = getMarkInfo(callAddr, argIdx, nargs);
   if (val == NULL){
     VG_(umsg)("This mark couldn't find a shadow value! This means either it lost the value, or there were no floating point operations on this value prior to hitting this mark.\n");
-    if (info->eagg.max_error < 0){
-      info->eagg.max_error = 0;
-    }
-    info->eagg.num_evals += 1;
+    addUnshadowedEvals(info, 1);
     return;
   }
-  double thisError =
-    updateError(&(info->eagg), val->real, clientValue);
-  if (thisError >= error_threshold){
-    inPlaceMergeInfluences(&(info->influences), val->influences);
+  updateMarkInfo(info, val, clientValue);
+}
+typedef struct _ArrayMark {
+  MarkInfo* info;
+  Addr start;
+  SizeT elemSize;
+  SizeT strideBytes;
+  HerbgrindElementType type;
+  long long int numFound;
+} ArrayMark;
+
+void markArrayValue(Addr addr, ShadowValue* val, void* closure);
+void markArrayValue(Addr addr, ShadowValue* val, void* closure){
+  ArrayMark* mark = closure;
+  // The walk hands us every shadow in the range, including ones in
+  // between elements and halves of doubles.
+  if ((addr - mark->start) % mark->strideBytes != 0){
+    return;
   }
-  if (!no_exprs && output_mark_exprs){
-    tl_assert(val->expr != NULL);
-    generalizeSymbolicExpr(&(info->expr), val->expr);
+  mark->numFound += 1;
+  if (mark->type == HERBGRIND_FLOAT){
+    updateMarkInfo(mark->info, val, *(float*)addr);
+  } else {
+    updateMarkInfo(mark->info, val, *(double*)addr);
+  }
+}
+void markImportantArray(Addr ptr, SizeT count, SizeT stride,
+                        HerbgrindElementType type){
+  if (no_influences) return;
+  if (count == 0) return;
+  if (stride == 0) stride = 1;
+  ArrayMark mark = {.info = getMarkInfo(getCallAddr(), 0, 1),
+                    .start = ptr,
+                    .elemSize = type == HERBGRIND_FLOAT ?
+                    sizeof(float) : sizeof(double),
+                    .type = type,
+                    .numFound = 0};
+  mark.strideBytes = mark.elemSize * stride;
+  if (mark.strideBytes > sizeof(double)){
+    // Sparse enough that walking the range would mostly look at
+    // slots in between elements.
+    for(SizeT i = 0; i < count; ++i){
+      Addr addr = ptr + i * mark.strideBytes;
+      ShadowValue* val = getMemShadow(addr);
+      if (val != NULL){
+        markArrayValue(addr, val, &mark);
+      }
+    }
+  } else {
+    forEachMemShadow(ptr, mark.strideBytes * (count - 1) + mark.elemSize,
+                     markArrayValue, &mark);
+  }
+  long long int numMissing = count - mark.numFound;
+  if (numMissing > 0){
+    VG_(umsg)("An array mark couldn't find shadow values for %lld "
+              "of its %lu elements.\n", numMissing, count);
+    addUnshadowedEvals(mark.info, numMissing);
+  }
+}
+void resetMarks(void){
+  VG_(HT_ResetIter)(markMap);
+  for(MarkInfoArray* markInfoArray = VG_(HT_Next)(markMap);
+      markInfoArray != NULL; markInfoArray = VG_(HT_Next)(markMap)){
+    for(int i = 0; i < markInfoArray->nmarks; ++i){
+      MarkInfo* info = &(markInfoArray->marks[i]);
+      initializeErrorAggregate(&(info->eagg));
+      disownInfluenceList(info->influences);
+      info->influences = NULL;
+    }
+  }
+  VG_(HT_ResetIter)(intMarkMap);
+  for(IntMarkInfo* info = VG_(HT_Next)(intMarkMap);
+      info != NULL; info = VG_(HT_Next)(intMarkMap)){
+    info->num_hits = 0;
+    info->num_mismatches = 0;
+    disownInfluenceList(info->influences);
+    info->influences = NULL;
   }
 }
 void markEscapeFromFloat(const char* markType,
@@ -135,9 +236,7 @@ MarkInfo* getMarkInfo(Addr callAddr, int argIdx, int nargs){
     for(int i = 0; i < nargs; ++i){
       markInfoArray->marks[i].addr = callAddr;
       markInfoArray->marks[i].influences = NULL;
-      markInfoArray->marks[i].eagg.max_error = -1;
-      markInfoArray->marks[i].eagg.total_error = 0;
-      markInfoArray->marks[i].eagg.num_evals = 0;
+      initializeErrorAggregate(&(markInfoArray->marks[i].eagg));
     }
     markInfoArray->addr = callAddr;
     VG_(HT_add_node)(markMap, markInfoArray);
@@ -165,11 +264,13 @@ int isSubexpr(SymbExpr* needle, SymbExpr* haystack, int depth){
 
 InfluenceList filterInfluenceSubexprs(InfluenceList influences){
   if (influences == NULL) return NULL;
-  InfluenceList result = mkInfluenceList();
-  for(int i = 0; i < influences->length; ++i){
-    ShadowOpInfo* influence = influences->data[i];
-    for(int j = 0; j < influences->length; ++j){
-      ShadowOpInfo* otherInfluence = influences->data[j];
+  InfluenceList result = NULL;
+  for(int i = nextInfluenceId(influences, -1); i >= 0;
+      i = nextInfluenceId(influences, i)){
+    ShadowOpInfo* influence = influenceInfos[i];
+    for(int j = nextInfluenceId(influences, -1); j >= 0;
+        j = nextInfluenceId(influences, j)){
+      ShadowOpInfo* otherInfluence = influenceInfos[j];
       if (otherInfluence == influence){
         continue;
       }
@@ -178,18 +279,62 @@ InfluenceList filterInfluenceSubexprs(InfluenceList influences){
         goto dont_keep_influence;
       }
     }
-    result->data[result->length++] = influences->data[i];
+    result = addInfluence(result, influence);
   dont_keep_influence:;
   }
   return result;
 }
 
+InfluenceList filterUnevaluatedInfluences(InfluenceList influences){
+  Bool anyUnevaluated = False;
+  for(int i = nextInfluenceId(influences, -1); i >= 0;
+      i = nextInfluenceId(influences, i)){
+    if (influenceInfos[i]->agg.global_error.num_evals == 0){
+      anyUnevaluated = True;
+      break;
+    }
+  }
+  // Unless the stats have been reset, every op has run, so don't
+  // bother rebuilding the list.
+  if (!anyUnevaluated){
+    return ownInfluenceList(influences);
+  }
+  InfluenceList result = NULL;
+  for(int i = nextInfluenceId(influences, -1); i >= 0;
+      i = nextInfluenceId(influences, i)){
+    if (influenceInfos[i]->agg.global_error.num_evals > 0){
+      result = addInfluence(result, influenceInfos[i]);
+    }
+  }
+  return result;
+}
+
+InfluenceList reportedInfluences(InfluenceList influences){
+  // Shadow values keep their influences across a stats reset, so
+  // leave out the ops that haven't run since, which have no error to
+  // report.
+  InfluenceList evaluated = filterUnevaluatedInfluences(influences);
+  // The subexpression filter is quadratic, and the sets can be huge,
+  // so only run it on the ones we might report.
+  InfluenceList worst = worstInfluences(evaluated);
+  disownInfluenceList(evaluated);
+  InfluenceList result = filterInfluenceSubexprs(worst);
+  disownInfluenceList(worst);
+  if (only_improvable){
+    InfluenceList improvable = filterUnimprovableInfluences(result);
+    disownInfluenceList(result);
+    result = improvable;
+  }
+  return result;
+}
+
 InfluenceList filterUnimprovableInfluences(InfluenceList influences){
   if (influences == NULL) return NULL;
-  InfluenceList result = mkInfluenceList();
-  for(int i = 0; i < influences->length; ++i){
-    if (hasRepeatedVars(influences->data[i]->expr)){
-      result->data[result->length++] = influences->data[i];
+  InfluenceList result = NULL;
+  for(int i = nextInfluenceId(influences, -1); i >= 0;
+      i = nextInfluenceId(influences, i)){
+    if (hasRepeatedVars(influenceInfos[i]->expr)){
+      result = addInfluence(result, influenceInfos[i]);
     }
   }
   return result;
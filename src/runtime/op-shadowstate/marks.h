@@ -33,6 +33,7 @@
 #include "../../helper/list.h"
 
 #include "shadowop-info.h"
+#include "../../include/herbgrind.h"
 #include "../value-shadowstate/value-shadowstate.h"
 #include "../value-shadowstate/shadowval.h"
 
@@ -68,14 +69,33 @@ void maybeMarkImportant(ShadowValue* val, double clientVal, int argIdx, int narg
 void maybeMarkImportantAtAddr(ShadowValue* val, double clientValue, int argIdx, int nargs,
                               Addr callAddr);
 void markImportant(ShadowValue* val, double clientVal, int argIdx, int nargs);
+void updateMarkInfo(MarkInfo* info, ShadowValue* val, double clientValue);
+// Marks every shadowed value in a buffer that's leaving the program,
+// all under a single mark for the call site.
+void markOutputBuffer(Addr callAddr, Addr buf, SizeT len);
+// Marks count elements starting at ptr, stride elements apart, all
+// under a single mark for the calling site.
+void markImportantArray(Addr ptr, SizeT count, SizeT stride,
+                        HerbgrindElementType type);
 void markEscapeFromFloat(const char* markType,
                          int mismatch,
                          int numVals, ShadowValue** values);
+// Starts the error and influences of every mark over.
+void resetMarks(void);
 IntMarkInfo* getIntMarkInfo(Addr callAddr, const char* markType);
 MarkInfo* getMarkInfo(Addr callAddr, int argIdx, int nargs);
 void printMarkInfo(MarkInfo* info);
 int isSubexpr(SymbExpr* needle, SymbExpr* haystack, int depth);
+// These return owned references to the filtered lists.
 InfluenceList filterInfluenceSubexprs(InfluenceList influences);
 InfluenceList filterUnimprovableInfluences(InfluenceList influences);
+// Drops the ops that haven't been evaluated since the stats were
+// last reset.
+InfluenceList filterUnevaluatedInfluences(InfluenceList influences);
+// The influences of a mark that make it into the output: the worst
+// --max-influences of the ones evaluated since the last reset,
+// filtered as the options ask. Like the filters, returns an owned
+// reference.
+InfluenceList reportedInfluences(InfluenceList influences);
 
 #endif
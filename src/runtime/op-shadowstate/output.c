@@ -28,8 +28,10 @@
 */
 
 #include "output.h"
+#include "binary-output.h"
 #include "pub_tool_vki.h"
 #include "pub_tool_libcprint.h"
+#include "pub_tool_libcbase.h"
 #include "pub_tool_libcfile.h"
 #include "pub_tool_clientstate.h"
 #include "pub_tool_debuginfo.h"
@@ -40,12 +42,58 @@
 
 #include "../shadowop/symbolic-op.h"
 #include "../../helper/runtime-util.h"
+#include "../../helper/symbol-cache.h"
 
 #define ENTRY_BUFFER_SIZE 2048000
 
+// Set once we're writing the final output, after which nothing
+// builds on the ops' expressions any more.
+Bool writingFinalOutput = False;
+
 void writeOutput(void){
+  writingFinalOutput = True;
+  writeOutputToFile(getOutputFilename());
+}
+
+SymbExpr* getOutputExpr(ShadowOpInfo* opinfo){
+  if (!var_swallow){
+    return opinfo->expr;
+  }
+  if (writingFinalOutput){
+    opinfo->expr = varSwallow(opinfo->expr);
+    return opinfo->expr;
+  }
+  return varSwallowCopy(opinfo->expr);
+}
+
+UInt numStatsDumps = 0;
+void dumpStats(const HChar* label, Bool reset){
+  const char* outputFilename = getOutputFilename();
+  HChar numLabel[16];
+  if (label == NULL){
+    VG_(snprintf)(numLabel, sizeof(numLabel), "%u", numStatsDumps);
+    label = numLabel;
+  }
+  numStatsDumps++;
+  SizeT filenameLen =
+    VG_(strlen)(outputFilename) + VG_(strlen)(label) + 2;
+  HChar* filename = VG_(malloc)("stats dump filename", filenameLen);
+  VG_(snprintf)(filename, filenameLen, "%s.%s", outputFilename, label);
+  writeOutputToFile(filename);
+  VG_(free)(filename);
+  if (reset){
+    resetStats();
+  }
+}
+
+void resetStats(void){
+  resetOpAggregates();
+  resetMarks();
+}
+
+void writeOutputToFile(const char* filename){
   SysRes fileResult =
-    VG_(open)(getOutputFilename(),
+    VG_(open)(filename,
               VKI_O_CREAT | VKI_O_TRUNC | VKI_O_WRONLY,
               VKI_S_IRUSR | VKI_S_IWUSR);
 
@@ -55,6 +103,12 @@ void writeOutput(void){
   }
   Int fileD = sr_Res(fileResult);
 
+  if (output_binary){
+    writeBinaryOutput(fileD);
+    VG_(close)(fileD);
+    return;
+  }
+
   if (VG_(HT_count_nodes)(markMap) == 0 &&
       !haveErroneousIntMarks()){
     if (!output_sexp){
@@ -62,6 +116,7 @@ void writeOutput(void){
       VG_(write)(fileD, output, sizeof(output));
     }
     VG_(printf)("Didn't find any marks!\n");
+    VG_(close)(fileD);
     return;
   }
   VG_(HT_ResetIter)(markMap);
@@ -78,12 +133,10 @@ void writeOutput(void){
         continue;
       }
 
-      if (!VG_(get_filename_linenum)(VG_(current_DiEpoch)(), markInfo->addr, &src_filename,
-                                     NULL, &src_line)){
-        src_line = -1;
-        src_filename = "Unknown";
-      }
-      fnname = getFnName(markInfo->addr);
+      SourceInfo* info = getSourceInfo(markInfo->addr);
+      src_filename = info->filename;
+      src_line = info->line;
+      fnname = info->fnname;
 
       BBuf* buf = mkBBuf(ENTRY_BUFFER_SIZE, _buf);
 
@@ -99,8 +152,8 @@ void writeOutput(void){
                   fnname, src_filename, src_line,
                   markInfo->addr);
         if (print_object_files){
-          const char* objfile_name;
-          if (!VG_(get_objname)(VG_(current_DiEpoch)(), markInfo->addr, &objfile_name)){
+          const char* objfile_name = info->objname;
+          if (objfile_name == NULL){
             objfile_name = "Unknown Object";
           }
           printBBuf(buf,
@@ -119,12 +172,22 @@ void writeOutput(void){
         }
         printBBuf(buf,
                   "  (avg-error %f)\n"
-                  "  (max-error %f)\n"
-                  "  (num-calls %lld)\n"
-                  "  (influences\n",
+                  "  (max-error %f)\n",
                   markInfo->eagg.total_error /
                   markInfo->eagg.num_evals,
-                  markInfo->eagg.max_error,
+                  markInfo->eagg.max_error);
+        if (error_quantiles){
+          printBBuf(buf,
+                    "  (p50-error %f)\n"
+                    "  (p90-error %f)\n"
+                    "  (p99-error %f)\n",
+                    errorQuantile(&(markInfo->eagg), 0.5),
+                    errorQuantile(&(markInfo->eagg), 0.9),
+                    errorQuantile(&(markInfo->eagg), 0.99));
+        }
+        printBBuf(buf,
+                  "  (num-calls %lld)\n"
+                  "  (influences\n",
                   markInfo->eagg.num_evals);
       } else {
         if (markInfoArray->nmarks > 1){
@@ -148,22 +211,28 @@ void writeOutput(void){
 
         printBBuf(buf,
                   "%f bits average error\n"
-                  "%f bits max error\n"
-                  "Aggregated over %lld instances\n"
-                  "Influenced by erroneous expression:\n",
+                  "%f bits max error\n",
                   markInfo->eagg.total_error /
                   markInfo->eagg.num_evals,
-                  markInfo->eagg.max_error,
+                  markInfo->eagg.max_error);
+        if (error_quantiles){
+          printBBuf(buf,
+                    "%f/%f/%f bits error at the 50th/90th/99th percentiles\n",
+                    errorQuantile(&(markInfo->eagg), 0.5),
+                    errorQuantile(&(markInfo->eagg), 0.9),
+                    errorQuantile(&(markInfo->eagg), 0.99));
+        }
+        printBBuf(buf,
+                  "Aggregated over %lld instances\n"
+                  "Influenced by erroneous expression:\n",
                   markInfo->eagg.num_evals);
       }
       unsigned int entryLen = ENTRY_BUFFER_SIZE - buf->bound;
       VG_(write)(fileD, _buf, entryLen);
 
-      InfluenceList filteredInfluences = filterInfluenceSubexprs(markInfo->influences);
-      if (only_improvable){
-        filteredInfluences = filterUnimprovableInfluences(filteredInfluences);
-      }
+      InfluenceList filteredInfluences = reportedInfluences(markInfo->influences);
       writeInfluences(fileD, filteredInfluences);
+      disownInfluenceList(filteredInfluences);
       if (output_sexp){
         char endparens[] = "  )\n)";
         VG_(write)(fileD, endparens, sizeof(endparens) - 1);
@@ -176,18 +245,13 @@ void writeOutput(void){
   for(IntMarkInfo* intMarkInfo = VG_(HT_Next)(intMarkMap);
       intMarkInfo != NULL; intMarkInfo = VG_(HT_Next)(intMarkMap)){
     if (intMarkInfo->num_mismatches == 0) continue;
-    const char* src_filename;
-    const char* fnname = getFnName(intMarkInfo->addr);
-    const char* objname;
-    unsigned int src_line;
+    SourceInfo* info = getSourceInfo(intMarkInfo->addr);
+    const char* src_filename = info->filename;
+    const char* fnname = info->fnname;
+    const char* objname = info->objname;
+    unsigned int src_line = info->line;
 
-    if (!VG_(get_filename_linenum)(VG_(current_DiEpoch)(), intMarkInfo->addr, &src_filename,
-                                   NULL, &src_line)){
-      src_line = -1;
-      src_filename = "Unknown";
-    }
-    if (print_object_files &&
-        !VG_(get_objname)(VG_(current_DiEpoch)(), intMarkInfo->addr, &objname)){
+    if (objname == NULL){
       objname = "Unknown object";
     }
 
@@ -261,17 +325,16 @@ void writeOutput(void){
     unsigned int entryLen = ENTRY_BUFFER_SIZE - buf->bound;
     VG_(write)(fileD, _buf, entryLen);
 
-    InfluenceList filteredInfluences = filterInfluenceSubexprs(intMarkInfo->influences);
-    if (only_improvable){
-      filteredInfluences = filterUnimprovableInfluences(filteredInfluences);
-    }
+    InfluenceList filteredInfluences = reportedInfluences(intMarkInfo->influences);
     writeInfluences(fileD, filteredInfluences);
+    disownInfluenceList(filteredInfluences);
     if (output_sexp){
       char endparens[] = "  )\n"
         ")\n\n";
       VG_(write)(fileD, endparens, sizeof(endparens) - 1);
     }
   }
+  VG_(free)(_buf);
   VG_(close)(fileD);
 }
 
@@ -279,7 +342,9 @@ const char* getOutputFilename(void){
   if (output_filename == NULL){
     char* default_filename = VG_(perm_malloc)(sizeof(char) * 100,
                                               vg_alignof(char));
-    VG_(snprintf)(default_filename, 100, "%s.gh", VG_(args_the_exename));
+    VG_(snprintf)(default_filename, 100,
+                  output_binary ? "%s.ghb" : "%s.gh",
+                  VG_(args_the_exename));
     return default_filename;
   } else {
     return output_filename;
@@ -316,8 +381,13 @@ void writeInfluences(Int fileD, InfluenceList influences){
     char startparen[] = "    (\n";
     VG_(write)(fileD, startparen, sizeof(startparen) - 1);
   }
-  for(int j = 0; influences != NULL && j < influences->length; ++j){
-    ShadowOpInfo* opinfo = influences->data[j];
+  ShadowOpInfo** rankedInfluences = NULL;
+  int numRankedInfluences = 0;
+  if (influences != NULL){
+    numRankedInfluences = rankInfluences(influences, &rankedInfluences);
+  }
+  for(int j = 0; j < numRankedInfluences; ++j){
+    ShadowOpInfo* opinfo = rankedInfluences[j];
 
     int numVars;
     char* exprString = NULL;
@@ -326,22 +396,20 @@ void writeInfluences(Int fileD, InfluenceList influences){
     RangeRecord* problematicRanges = NULL;
     double* exampleProblematicArgs = NULL;
     if (!no_exprs){
-      if (var_swallow){
-        opinfo->expr = varSwallow(opinfo->expr);
-      }
-      exprString = symbExprToString(opinfo->expr, &numVars);
+      SymbExpr* expr = getOutputExpr(opinfo);
+      exprString = symbExprToString(expr, &numVars);
       getRangesAndExample(&totalRanges, &problematicRanges, &exampleProblematicArgs,
-                          opinfo->expr, numVars);
+                          expr, numVars);
       varString = symbExprVarString(numVars);
+      freeSwallowedExpr(expr);
     }
 
-    if (!VG_(get_filename_linenum)(VG_(current_DiEpoch)(), opinfo->op_addr, &src_filename,
-                                   NULL, &src_line)){
-      src_line = -1;
-      src_filename = "Unknown";
-    }
-    const char* fnname = getFnName(opinfo->op_addr);
-    if (!VG_(get_objname)(VG_(current_DiEpoch)(), opinfo->op_addr, &objname)){
+    SourceInfo* info = getSourceInfo(opinfo->op_addr);
+    src_filename = info->filename;
+    src_line = info->line;
+    const char* fnname = info->fnname;
+    objname = info->objname;
+    if (objname == NULL){
       objname = "Unknown object";
     }
 
@@ -391,6 +459,9 @@ void writeInfluences(Int fileD, InfluenceList influences){
           if (!fpcore_ranges || flip_ranges){
             writeRanges(buf, numVars, totalRanges);
           }
+          if (input_histograms){
+            writeInputHistograms(buf, numVars, totalRanges);
+          }
         }
         writeExample(buf, numVars, exampleProblematicArgs);
       }
@@ -412,14 +483,26 @@ void writeInfluences(Int fileD, InfluenceList influences){
                 "     (avg-error %f)\n"
                 "     (max-error %f)\n"
                 "     (avg-local-error %f)\n"
-                "     (max-local-error %f)\n"
-                "     (num-calls %lld))\n",
+                "     (max-local-error %f)\n",
                 global_error.total_error
                 / global_error.num_evals,
                 global_error.max_error,
                 local_error.total_error
                 / global_error.num_evals,
-                local_error.max_error,
+                local_error.max_error);
+      if (error_quantiles){
+        printBBuf(buf,
+                  "     (p50-error %f)\n"
+                  "     (p90-error %f)\n"
+                  "     (p99-error %f)\n"
+                  "     (p99-local-error %f)\n",
+                  errorQuantile(&global_error, 0.5),
+                  errorQuantile(&global_error, 0.9),
+                  errorQuantile(&global_error, 0.99),
+                  errorQuantile(&local_error, 0.99));
+      }
+      printBBuf(buf,
+                "     (num-calls %lld))\n",
                 global_error.num_evals);
     } else {
       if (!no_exprs){
@@ -470,6 +553,9 @@ void writeInfluences(Int fileD, InfluenceList influences){
         if (!fpcore_ranges || !flip_ranges){
           writeProblematicRanges(buf, numVars, problematicRanges);
         }
+        if (input_histograms){
+          writeInputHistograms(buf, numVars, totalRanges);
+        }
         writeExample(buf, numVars, exampleProblematicArgs);
       }
       ErrorAggregate local_error = opinfo->agg.local_error;
@@ -478,14 +564,24 @@ void writeInfluences(Int fileD, InfluenceList influences){
                 "   %f bits average error\n"
                 "   %f bits max error\n"
                 "   %f bits average local error\n"
-                "   %f bits max local error\n"
-                "   Aggregated over %lld instances\n",
+                "   %f bits max local error\n",
                 global_error.total_error
                 / global_error.num_evals,
                 global_error.max_error,
                 local_error.total_error
                 / global_error.num_evals,
-                local_error.max_error,
+                local_error.max_error);
+      if (error_quantiles){
+        printBBuf(buf,
+                  "   %f/%f/%f bits error at the 50th/90th/99th percentiles\n"
+                  "   %f bits local error at the 99th percentile\n",
+                  errorQuantile(&global_error, 0.5),
+                  errorQuantile(&global_error, 0.9),
+                  errorQuantile(&global_error, 0.99),
+                  errorQuantile(&local_error, 0.99));
+      }
+      printBBuf(buf,
+                "   Aggregated over %lld instances\n",
                 global_error.num_evals);
     }
     unsigned int entryLen = ENTRY_BUFFER_SIZE - buf->bound;
@@ -493,6 +589,9 @@ void writeInfluences(Int fileD, InfluenceList influences){
     VG_(free)(varString);
     VG_(write)(fileD, _buf, entryLen);
   }
+  if (rankedInfluences != NULL){
+    VG_(free)(rankedInfluences);
+  }
   if (output_sexp){
     char endparen[] = "    )\n";
     VG_(write)(fileD, endparen, sizeof(endparen) - 1);
@@ -601,6 +700,29 @@ void writeExample(BBuf* buf, int numVars, double* exampleProblematicInput){
   }
 }
 
+void writeInputHistograms(BBuf* buf, int numVars, RangeRecord* ranges){
+  if (output_sexp){
+    printBBuf(buf,
+              "     (var-input-histograms");
+    for(int i = 0; i < numVars; ++i){
+      if (ranges[i].histogram == NULL) continue;
+      printBBuf(buf,
+                "\n       (%s",
+                getVar(i));
+      writeInputHistogram(buf, ranges[i].histogram);
+      printBBuf(buf, ")");
+    }
+    printBBuf(buf, ")\n");
+  } else {
+    for(int i = 0; i < numVars; ++i){
+      if (ranges[i].histogram == NULL) continue;
+      printBBuf(buf, "      %s magnitudes:", getVar(i));
+      writeInputHistogram(buf, ranges[i].histogram);
+      printBBuf(buf, "\n");
+    }
+  }
+}
+
 void writeRanges(BBuf* buf, int numVars, RangeRecord* ranges){
   if (output_sexp){
     printBBuf(buf,
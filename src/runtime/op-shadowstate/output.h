@@ -35,10 +35,26 @@
 #include "../../helper/bbuf.h"
 
 void writeOutput(void);
+void writeOutputToFile(const char* filename);
+// Writes the current results to <outfile>.<label>, or
+// <outfile>.<n> for the nth dump if label is NULL, and then resets
+// them if reset is set.
+void dumpStats(const HChar* label, Bool reset);
+// Clears the error and range information gathered for every op, and
+// the error and influences of every mark. Shadow values are kept,
+// along with the influences they carry, so a mark hit after the
+// reset can still be blamed on ops from before it; we only leave out
+// the ones that haven't run again since.
+void resetStats(void);
 
 const char* getOutputFilename(void);
 int haveErroneousIntMarks(void);
 void writeInfluences(Int fileD, InfluenceList influences);
+// The expression to print for an op, var swallowed if the options
+// ask for it. Until the final output, the op's own expression is
+// left alone, since the rest of the run keeps building on it, so
+// release the result with freeSwallowedExpr.
+SymbExpr* getOutputExpr(ShadowOpInfo* opinfo);
 void writeRangesAndExample(BBuf* buf, int numVars,
                            RangeRecord* ranges,
                            RangeRecord* problematicRanges,
@@ -46,4 +62,5 @@ void writeRangesAndExample(BBuf* buf, int numVars,
 void writeProblematicRanges(BBuf* buf, int numVars, RangeRecord* problematicRanges);
 void writeExample(BBuf* buf, int numVars, double* exampleProblematicInput);
 void writeRanges(BBuf* buf, int numVars, RangeRecord* ranges);
+void writeInputHistograms(BBuf* buf, int numVars, RangeRecord* ranges);
 #endif
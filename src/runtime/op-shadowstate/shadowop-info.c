@@ -32,9 +32,11 @@
 #include "pub_tool_debuginfo.h"
 #include "pub_tool_libcprint.h"
 #include "pub_tool_libcbase.h"
+#include "pub_tool_xarray.h"
 #include "../../helper/ir-info.h"
 #include "../../helper/bbuf.h"
 #include "../../helper/runtime-util.h"
+#include "../../helper/symbol-cache.h"
 #include "../shadowop/mathreplace.h"
 
 #include <math.h>
@@ -42,12 +44,16 @@
 
 VgHashTable* mathreplaceOpInfoMap = NULL;
 VgHashTable* semanticOpInfoMap = NULL;
+// Every op info we've made, so that we can reset them all.
+XArray* allOpInfos = NULL;
 
 void initOpShadowState(void){
   mathreplaceOpInfoMap = VG_(HT_construct)("call map mathreplace");
   semanticOpInfoMap = VG_(HT_construct)("call map semantic op");
   markMap = VG_(HT_construct)("mark map");
   intMarkMap = VG_(HT_construct)("int mark map");
+  allOpInfos = VG_(newXA)(VG_(malloc), "all op infos",
+                          VG_(free), sizeof(ShadowOpInfo*));
 }
 
 ShadowOpInfo* mkShadowOpInfo(IROp_Extended op_code, OpType type,
@@ -60,6 +66,7 @@ ShadowOpInfo* mkShadowOpInfo(IROp_Extended op_code, OpType type,
   result->op_type = type;
 
   result->expr = NULL;
+  result->influence_id = -1;
   if (nargs != numFloatArgs(result)){
     printOpInfo(result);
     VG_(printf)("\n");
@@ -68,13 +75,59 @@ ShadowOpInfo* mkShadowOpInfo(IROp_Extended op_code, OpType type,
              "nargs and numArgs don't match! nargs is %d, but numArgs returns %d",
              nargs, numFloatArgs(result));
   initializeAggregate(&(result->agg), nargs);
+  VG_(addToXA)(allOpInfos, &result);
   return result;
 }
 
+void resetOpAggregates(void){
+  for(Word i = 0; i < VG_(sizeXA)(allOpInfos); ++i){
+    ShadowOpInfo* info = *(ShadowOpInfo**)VG_(indexXA)(allOpInfos, i);
+    initializeErrorAggregate(&(info->agg.global_error));
+    initializeErrorAggregate(&(info->agg.local_error));
+    for(int j = 0; j < numFloatArgs(info); ++j){
+      RangeRecord* record = &(info->agg.inputs.range_records[j]);
+      initRange(&(record->pos_range));
+      if (detailed_ranges){
+        initRange(&(record->neg_range));
+      }
+      if (record->histogram != NULL){
+        VG_(memset)(record->histogram, 0, sizeof(InputHistogram));
+      }
+    }
+  }
+}
+
 void initializeErrorAggregate(ErrorAggregate* error_agg){
   error_agg->max_error = -1;
+  error_agg->max_ulps = 0;
   error_agg->total_error = 0;
   error_agg->num_evals = 0;
+  for(int i = 0; i < ERROR_HISTOGRAM_BINS; ++i){
+    error_agg->error_bins[i] = 0;
+  }
+}
+
+// Estimates the given quantile of bits of error from the histogram,
+// interpolating within the bin it falls in.
+double errorQuantile(ErrorAggregate* error_agg, double quantile){
+  ULong total = 0;
+  for(int i = 0; i < ERROR_HISTOGRAM_BINS; ++i){
+    total += error_agg->error_bins[i];
+  }
+  if (total == 0){
+    return 0;
+  }
+  double target = quantile * total;
+  ULong seen = 0;
+  for(int i = 0; i < ERROR_HISTOGRAM_BINS; ++i){
+    ULong count = error_agg->error_bins[i];
+    if (count > 0 && seen + count >= target){
+      double estimate = i + (target - seen) / count;
+      return estimate < error_agg->max_error ? estimate : error_agg->max_error;
+    }
+    seen += count;
+  }
+  return error_agg->max_error;
 }
 
 void initializeAggregate(Aggregate* agg, int nargs){
@@ -86,55 +139,41 @@ void initializeAggregate(Aggregate* agg, int nargs){
     if (detailed_ranges){
       initRange(&(agg->inputs.range_records[i].neg_range));
     }
+    agg->inputs.range_records[i].histogram =
+      input_histograms ? mkInputHistogram() : NULL;
   }
 }
 
 void ppAddr(Addr addr){
-  const HChar* src_filename;
-  const HChar* fnname;
-  UInt src_line;
-  if (VG_(get_filename_linenum)(VG_(current_DiEpoch)(), addr, &src_filename,
-                                NULL, &src_line)){
-    VG_(get_fnname)(VG_(current_DiEpoch)(), addr, &fnname);
+  SourceInfo* info = getSourceInfo(addr);
+  if (info->hasLine){
     VG_(printf)("%s:%u in %s (addr %lX)",
-                src_filename, src_line, fnname, addr);
+                info->filename, info->line, info->fnname, addr);
+  } else if (info->fnname[0] != '\0'){
+    VG_(printf)("%s (addr %lX)", info->fnname, addr);
   } else {
-    if (VG_(get_fnname)(VG_(current_DiEpoch)(), addr, &fnname)){
-      VG_(printf)("%s (addr %lX)", fnname, addr);
-    } else {
-      VG_(printf)("addr %lX", addr);
-    }
+    VG_(printf)("addr %lX", addr);
   }
   if (print_object_files){
-    const HChar* objname;
-    if (!VG_(get_objname)(VG_(current_DiEpoch)(), addr, &objname)){
-      objname = "Unknown Object";
-    }
-    VG_(printf)(" in %s", objname);
+    VG_(printf)(" in %s",
+                info->objname == NULL ? "Unknown Object" : info->objname);
   }
 }
 #define MAX_ADDR_STRING_SIZE 300
 char* getAddrString(Addr addr){
-  const HChar* src_filename;
-  const HChar* fnname;
-  UInt src_line;
+  SourceInfo* info = getSourceInfo(addr);
   char _buf[MAX_ADDR_STRING_SIZE];
   BBuf* buf = mkBBuf(MAX_ADDR_STRING_SIZE, _buf);
 
-  if (VG_(get_filename_linenum)(VG_(current_DiEpoch)(), addr, &src_filename,
-                                NULL, &src_line)){
-    fnname = getFnName(addr);
+  if (info->hasLine){
     printBBuf(buf, "%s:%u in %s (addr %lX)",
-              src_filename, src_line, fnname, addr);
+              info->filename, info->line, info->fnname, addr);
   } else {
     printBBuf(buf, "addr %lX", addr);
   }
   if (print_object_files){
-    const HChar* objname;
-    if (!VG_(get_objname)(VG_(current_DiEpoch)(), addr, &objname)){
-      objname = "Unknown Object";
-    }
-    printBBuf(buf, " in %s", objname);
+    printBBuf(buf, " in %s",
+              info->objname == NULL ? "Unknown Object" : info->objname);
   }
   char* result = VG_(malloc)("addr string", MAX_ADDR_STRING_SIZE - buf->bound + 1);
   VG_(strcpy)(result, _buf);
@@ -165,37 +204,8 @@ int numFloatArgs(ShadowOpInfo* opinfo){
   }
 }
 
-// WARNING: this function never frees its result, call sparingly
 const char* getFnName(Addr addr){
-  const char* fnname;
-  VG_(get_fnname)(VG_(current_DiEpoch)(), addr, &fnname);
-  if (isPrefix("caml", fnname)){
-    char* demangledFnname = VG_(perm_malloc)(sizeof(char) * VG_(strlen)(fnname), 1);
-    int n = 0;
-    for(const char* p = fnname + 4; *p != '\0'; ++p){
-      if (p[0] == '_' && p[1] == '_'){
-        demangledFnname[n++] = '.';
-        p++;
-        continue;
-      }
-      if (p[0] == '_'){
-        Bool restIsTag = True;
-        for (const char* q = p + 1; *q != '\0'; ++q){
-          if (!VG_(isdigit)(*q)){
-            restIsTag = False;
-            break;
-          }
-        }
-        if (restIsTag){
-          demangledFnname[n++] = '\0';
-          break;
-        }
-      }
-      demangledFnname[n++] = *p;
-    }
-    return demangledFnname;
-  }
-  return fnname;
+  return getSourceInfo(addr)->fnname;
 }
 
 int cmpInfo(ShadowOpInfo* info1, ShadowOpInfo* info2){
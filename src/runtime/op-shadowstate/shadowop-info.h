@@ -46,10 +46,17 @@ extern VgHashTable* semanticOpInfoMap;
 extern VgHashTable* markMap;
 extern VgHashTable* intMarkMap;
 
+// One bin per whole bit of error, from 0 up to 64.
+#define ERROR_HISTOGRAM_BINS 65
+
 typedef struct _ErrorAggregate {
   double max_error;
+  ULong max_ulps;
   double total_error;
   long long int num_evals;
+  // How many evaluations fell in each bin, so we can report
+  // quantiles and not just the average and max.
+  ULong error_bins[ERROR_HISTOGRAM_BINS];
 } ErrorAggregate;
 
 typedef struct _InputsRecord {
@@ -71,6 +78,9 @@ typedef struct _ShadowOpInfo {
   Addr block_addr;
   Aggregate agg;
   SymbExpr* expr;
+  // Dense index into influence sets, or -1 if this op has never been
+  // flagged as an influence.
+  int influence_id;
 } ShadowOpInfo;
 
 typedef struct _ShadowOpInfoInstance {
@@ -104,6 +114,9 @@ ShadowOpInfo* mkShadowOpInfo(IROp_Extended op_code, OpType type,
                              int nargs);
 void initializeAggregate(Aggregate* agg, int nargs);
 void initializeErrorAggregate(ErrorAggregate* error_agg);
+// Starts the error and input range aggregates of every op over.
+void resetOpAggregates(void);
+double errorQuantile(ErrorAggregate* error_agg, double quantile);
 
 typedef struct _ShadowValue ShadowValue;
 void updateInputRecords(InputsRecord* record, ShadowValue** args, int nargs);
@@ -0,0 +1,134 @@
+/*--------------------------------------------------------------------*/
+/*--- Herbgrind: a valgrind tool for Herbie             snapshot.c ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Herbgrind, a valgrind tool for diagnosing
+   floating point accuracy problems in binary programs and extracting
+   problematic expressions.
+
+   Copyright (C) 2016-2017 Alex Sanchez-Stern
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#include "snapshot.h"
+#include "output.h"
+#include "binary-output.h"
+#include "pub_tool_vki.h"
+#include "pub_tool_libcprint.h"
+#include "pub_tool_libcfile.h"
+#include "pub_tool_libcbase.h"
+#include "pub_tool_libcproc.h"
+#include "pub_tool_mallocfree.h"
+#include "../../options.h"
+
+ULong snapshotCountdown = -1;
+
+Long snapshotInterval = 0;
+Bool snapshotIntervalInBlocks = False;
+UInt nextSnapshotTime = 0;
+UInt numSnapshots = 0;
+HChar* snapshotFilename = NULL;
+HChar* snapshotTmpFilename = NULL;
+
+void initSnapshots(void){
+  if (snapshot_interval_arg == NULL){
+    return;
+  }
+  HChar* end;
+  snapshotInterval = VG_(strtoll10)(snapshot_interval_arg, &end);
+  if (*end == 'b' && end[1] == '\0'){
+    snapshotIntervalInBlocks = True;
+  } else if (!((*end == 's' && end[1] == '\0') || *end == '\0')){
+    VG_(fmsg_bad_option)(snapshot_interval_arg,
+                         "--snapshot-interval takes a number of "
+                         "seconds, or a number of blocks followed by "
+                         "'b'.\n");
+  }
+  if (snapshotInterval <= 0){
+    VG_(fmsg_bad_option)(snapshot_interval_arg,
+                         "--snapshot-interval must be positive.\n");
+  }
+  if (snapshotIntervalInBlocks){
+    snapshotCountdown = snapshotInterval;
+  } else {
+    snapshotCountdown = SNAPSHOT_POLL_BLOCKS;
+    nextSnapshotTime =
+      VG_(read_millisecond_timer)() + snapshotInterval * 1000;
+  }
+}
+
+Bool snapshotsEnabled(void){
+  return snapshotInterval > 0;
+}
+
+VG_REGPARM(0) void snapshotTick(void){
+  if (snapshotIntervalInBlocks){
+    snapshotCountdown = snapshotInterval;
+    takeSnapshot();
+  } else {
+    snapshotCountdown = SNAPSHOT_POLL_BLOCKS;
+    UInt now = VG_(read_millisecond_timer)();
+    if (now >= nextSnapshotTime){
+      takeSnapshot();
+      nextSnapshotTime = now + snapshotInterval * 1000;
+    }
+  }
+}
+
+void takeSnapshot(void){
+  if (snapshotFilename == NULL){
+    const char* outputFilename = getOutputFilename();
+    SizeT filenameLen = VG_(strlen)(outputFilename) + 10;
+    snapshotFilename = VG_(malloc)("snapshot filename", filenameLen);
+    VG_(snprintf)(snapshotFilename, filenameLen, "%s.snapshot",
+                  outputFilename);
+    filenameLen += 4;
+    snapshotTmpFilename = VG_(malloc)("snapshot filename", filenameLen);
+    VG_(snprintf)(snapshotTmpFilename, filenameLen, "%s.tmp",
+                  snapshotFilename);
+  }
+  // Each snapshot is written whole to a temporary file and then moved
+  // over the last one, so the snapshot file never grows past the size
+  // of the results, and a reader never sees half of one.
+  SysRes fileResult =
+    VG_(open)(snapshotTmpFilename,
+              VKI_O_CREAT | VKI_O_TRUNC | VKI_O_WRONLY,
+              VKI_S_IRUSR | VKI_S_IWUSR);
+  if (sr_isError(fileResult)){
+    VG_(printf)("Couldn't open snapshot file %s!\n", snapshotTmpFilename);
+    return;
+  }
+  Int fileD = sr_Res(fileResult);
+  writeBinarySnapshot(fileD, numSnapshots++);
+  VG_(close)(fileD);
+  if (VG_(rename)(snapshotTmpFilename, snapshotFilename) != 0){
+    VG_(printf)("Couldn't move snapshot file into place at %s!\n",
+                snapshotFilename);
+  }
+}
+
+void finishSnapshots(void){
+  if (snapshotFilename != NULL){
+    VG_(free)(snapshotFilename);
+    VG_(free)(snapshotTmpFilename);
+    snapshotFilename = NULL;
+    snapshotTmpFilename = NULL;
+  }
+}
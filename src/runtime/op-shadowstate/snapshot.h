@@ -0,0 +1,49 @@
+/*--------------------------------------------------------------------*/
+/*--- Herbgrind: a valgrind tool for Herbie             snapshot.h ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Herbgrind, a valgrind tool for diagnosing
+   floating point accuracy problems in binary programs and extracting
+   problematic expressions.
+
+   Copyright (C) 2016-2017 Alex Sanchez-Stern
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+#ifndef _SNAPSHOT_H
+#define _SNAPSHOT_H
+
+#include "pub_tool_basics.h"
+
+// How many blocks to run between checks of the clock, when the
+// snapshot interval is in seconds.
+#define SNAPSHOT_POLL_BLOCKS 1000000
+
+// Instrumented blocks count this down, and call snapshotTick when it
+// hits zero.
+extern ULong snapshotCountdown;
+
+void initSnapshots(void);
+Bool snapshotsEnabled(void);
+VG_REGPARM(0) void snapshotTick(void);
+// Replaces the snapshot file with the results so far.
+void takeSnapshot(void);
+void finishSnapshots(void);
+
+#endif
@@ -35,18 +35,79 @@
 #include "pub_tool_libcprint.h"
 #include <math.h>
 
-double updateError(ErrorAggregate* eagg,
-                   Real realVal, double computedVal){
-  if (no_reals) return 0.0;
+// The smallest error in ulps that counts as error_threshold bits, so
+// that the hot paths can compare errors without taking logs.
+ULong error_threshold_ulps = 0;
+ULong error_exceeds_threshold_ulps = 0;
+// log2(1 + i / 2^ERROR_LOG_TABLE_BITS), for approximating bits of
+// error from the bits below the leading one.
+double errorLogTable[1 << ERROR_LOG_TABLE_BITS];
+
+ULong ulpsThreshold(double ulps);
+ULong ulpsThreshold(double ulps){
+  if (ulps <= 0){
+    return 0;
+  } else if (ulps >= 18446744073709551615.0){
+    return ULLONG_MAX;
+  } else {
+    return (ULong)ulps;
+  }
+}
+
+void initErrorComputation(void){
+  for(int i = 0; i < (1 << ERROR_LOG_TABLE_BITS); ++i){
+    errorLogTable[i] = log2(1.0 + (double)i / (1 << ERROR_LOG_TABLE_BITS));
+  }
+  // Bits of error are log2(ulps + 1), and ulps are whole numbers, so
+  // bits >= T exactly when ulps >= ceil(2^T - 1), and bits > T
+  // exactly when ulps >= floor(2^T - 1) + 1.
+  error_threshold_ulps = ulpsThreshold(ceil(exp2(error_threshold) - 1));
+  error_exceeds_threshold_ulps =
+    ulpsThreshold(floor(exp2(error_threshold) - 1) + 1);
+}
+
+// Approximates log2(ulpsError + 1) to within about 0.006 bits, using
+// the position of the leading one for the whole part and a table
+// lookup on the next few bits for the fraction. The whole part is
+// exact, so this always lands in the right histogram bin.
+double fastBitsError(ULong ulpsError){
+  ULong n = ulpsError + 1;
+  if (n == 0){
+    // ulpsError was ULLONG_MAX.
+    return 64;
+  }
+  int leading = 63 - __builtin_clzll(n);
+  ULong fraction;
+  if (leading >= ERROR_LOG_TABLE_BITS){
+    fraction = n >> (leading - ERROR_LOG_TABLE_BITS);
+  } else {
+    fraction = n << (ERROR_LOG_TABLE_BITS - leading);
+  }
+  return leading +
+    errorLogTable[fraction & ((1 << ERROR_LOG_TABLE_BITS) - 1)];
+}
+
+ULong updateError(ErrorAggregate* eagg,
+                  Real realVal, double computedVal){
+  if (no_reals) return 0;
   double shadowRounded = getDouble(realVal);
   ULong ulpsError = ulpd(shadowRounded, computedVal);
 
-  double bitsError = log2(ulpsError + 1);
-  if (bitsError > eagg->max_error){
-    eagg->max_error = bitsError;
+  double bitsError = fastBitsError(ulpsError);
+  // The max is reported, so keep it exact. It changes rarely, so
+  // this log is off the common path.
+  if (eagg->num_evals == 0 || ulpsError > eagg->max_ulps){
+    eagg->max_ulps = ulpsError;
+    eagg->max_error = log2((double)ulpsError + 1);
+  }
+  // The average is reported too, so add up exact bits there. Most
+  // evaluations have no error at all, and those skip the log.
+  if (ulpsError != 0){
+    eagg->total_error += log2((double)ulpsError + 1);
   }
-  eagg->total_error += bitsError;
   eagg->num_evals += 1;
+  int bin = (int)bitsError;
+  eagg->error_bins[bin < ERROR_HISTOGRAM_BINS ? bin : ERROR_HISTOGRAM_BINS - 1]++;
 
 
   // Debug printing code
@@ -73,7 +134,7 @@ double updateError(ErrorAggregate* eagg,
     VG_(printf)("%f bits error (%llu ulps)\n",
                 bitsError, ulpsError);
   }
-  return bitsError;
+  return ulpsError;
 }
 
 ULong ulpd(double x, double y){
@@ -33,8 +33,22 @@
 #include "../value-shadowstate/real.h"
 #include "../op-shadowstate/shadowop-info.h"
 
-double updateError(ErrorAggregate* eagg,
-                   Real realVal, double computedVal);
+// How many bits after the leading one fastBitsError looks at.
+#define ERROR_LOG_TABLE_BITS 8
+
+// The fewest ulps of error that is at least error_threshold bits,
+// and the fewest that is more than it.
+extern ULong error_threshold_ulps;
+extern ULong error_exceeds_threshold_ulps;
+
+void initErrorComputation(void);
+double fastBitsError(ULong ulpsError);
+// Records the error of computedVal against realVal, and returns it in
+// ulps; compare against error_threshold_ulps or
+// error_exceeds_threshold_ulps to check it against the error
+// threshold.
+ULong updateError(ErrorAggregate* eagg,
+                  Real realVal, double computedVal);
 ULong ulpd(double val1, double val2);
 
 #endif
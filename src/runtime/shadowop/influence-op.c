@@ -32,6 +32,54 @@
 #include "../value-shadowstate/value-shadowstate.h"
 #include "../value-shadowstate/exprs.h"
 
+// Loops tend to merge the same pairs of influence sets over and over,
+// so we remember recent merges. Since lists are interned, a pair of
+// list pointers identifies the sets exactly; each entry holds a
+// reference to its inputs so those pointers can't be reused while
+// it's in the cache.
+InfluenceCacheEntry influenceCache[INFLUENCE_CACHE_SIZE];
+ULong influenceCacheHits = 0;
+ULong influenceCacheMisses = 0;
+
+InfluenceList cachedMergeInfluences(InfluenceList il1, InfluenceList il2,
+                                    ShadowOpInfo* extra){
+  // These are already constant time in mergeInfluences, so don't let
+  // them take up cache space.
+  if (extra == NULL && (il1 == NULL || il2 == NULL || il1 == il2)){
+    return mergeInfluences(il1, il2, extra);
+  }
+  UWord hash = ((UWord)il1 >> 4) * 31 + ((UWord)il2 >> 4);
+  hash = hash * 31 + ((UWord)extra >> 4);
+  InfluenceCacheEntry* entry =
+    &(influenceCache[(hash ^ (hash >> 12)) & (INFLUENCE_CACHE_SIZE - 1)]);
+  if (entry->result != NULL && entry->il1 == il1 &&
+      entry->il2 == il2 && entry->extra == extra){
+    influenceCacheHits++;
+    return ownInfluenceList(entry->result);
+  }
+  influenceCacheMisses++;
+  InfluenceList result = mergeInfluences(il1, il2, extra);
+  disownInfluenceList(entry->il1);
+  disownInfluenceList(entry->il2);
+  disownInfluenceList(entry->result);
+  entry->il1 = ownInfluenceList(il1);
+  entry->il2 = ownInfluenceList(il2);
+  entry->extra = extra;
+  entry->result = ownInfluenceList(result);
+  return result;
+}
+
+void printInfluenceCacheStats(void){
+  ULong lookups = influenceCacheHits + influenceCacheMisses;
+  VG_(printf)("Influence merge cache: %llu hits, %llu misses",
+              influenceCacheHits, influenceCacheMisses);
+  if (lookups > 0){
+    VG_(printf)(" (%llu%% hit rate)",
+                influenceCacheHits * 100 / lookups);
+  }
+  VG_(printf)("\n");
+}
+
 void execInfluencesOp(ShadowOpInfo* info,
                       InfluenceList* res, ShadowValue** args,
                       Bool flagged){
@@ -44,57 +92,45 @@ void execInfluencesOp(ShadowOpInfo* info,
     return;
   }
   if (numFloatArgs(info) == 1){
-    *res = mergeInfluences(args[0]->influences, NULL,
-                           flagged ? info : NULL);
+    *res = cachedMergeInfluences(args[0]->influences, NULL,
+                                 flagged ? info : NULL);
   } else if (numFloatArgs(info) == 2){
-    *res = mergeInfluences(args[0]->influences, args[1]->influences,
-                           flagged ? info : NULL);
+    *res = cachedMergeInfluences(args[0]->influences, args[1]->influences,
+                                 flagged ? info : NULL);
   } else if (numFloatArgs(info) == 3){
-    InfluenceList intermediary = mergeInfluences(args[0]->influences,
-                                                 args[1]->influences,
-                                                 flagged ? info : NULL);
+    InfluenceList intermediary =
+      cachedMergeInfluences(args[0]->influences, args[1]->influences,
+                            flagged ? info : NULL);
 
-    *res = mergeInfluences(intermediary, args[2]->influences, NULL);
-    if (intermediary != NULL){
-      freeInfluenceList(intermediary);
-    }
+    *res = cachedMergeInfluences(intermediary, args[2]->influences, NULL);
+    disownInfluenceList(intermediary);
   } else {
     tl_assert(numFloatArgs(info) == 4);
-    InfluenceList intermediary1 = mergeInfluences(args[0]->influences,
-                                                  args[1]->influences,
-                                                  flagged ? info : NULL);
-    InfluenceList intermediary2 = mergeInfluences(args[2]->influences,
-                                                  args[3]->influences,
-                                                  NULL);
-    *res = mergeInfluences(intermediary1, intermediary2, NULL);
-    if (intermediary1 != NULL){
-      freeInfluenceList(intermediary1);
-    }
-    if (intermediary2 != NULL){
-      freeInfluenceList(intermediary2);
-    }
+    InfluenceList intermediary1 =
+      cachedMergeInfluences(args[0]->influences, args[1]->influences,
+                            flagged ? info : NULL);
+    InfluenceList intermediary2 =
+      cachedMergeInfluences(args[2]->influences, args[3]->influences,
+                            NULL);
+    *res = cachedMergeInfluences(intermediary1, intermediary2, NULL);
+    disownInfluenceList(intermediary1);
+    disownInfluenceList(intermediary2);
   }
 }
 
 void inPlaceMergeInfluences(InfluenceList* dest, InfluenceList arg){
   InfluenceList lst = mergeInfluences(*dest, arg, NULL);
-  if (*dest != NULL){
-    freeInfluenceList(*dest);
-  }
+  disownInfluenceList(*dest);
   *dest = lst;
 }
 void trackOpAsInfluence(ShadowOpInfo* info, ShadowValue* value){
   if (no_influences){
     return;
   }
-  InfluenceList lst = mergeInfluences(value->influences, NULL, info);
-  if (value->influences != NULL){
-    freeInfluenceList(value->influences);
-  }
-  value->influences = lst;
+  value->influences = addInfluence(value->influences, info);
 }
 InfluenceList cloneInfluences(InfluenceList influences){
-  return mergeInfluences(influences, NULL, NULL);
+  return ownInfluenceList(influences);
 }
 
 void forceTrack(Addr varAddr){
@@ -32,6 +32,17 @@
 
 #include "../value-shadowstate/shadowval.h"
 
+// The number of entries in the direct-mapped cache of influence
+// merges. Must be a power of two.
+#define INFLUENCE_CACHE_SIZE 4096
+
+typedef struct _influenceCacheEntry {
+  InfluenceList il1;
+  InfluenceList il2;
+  ShadowOpInfo* extra;
+  InfluenceList result;
+} InfluenceCacheEntry;
+
 void trackOpAsInfluence(ShadowOpInfo* info, ShadowValue* value);
 void forceTrack(Addr varAddr);
 void forceTrackF(Addr varAddr);
@@ -39,6 +50,9 @@ void execInfluencesOp(ShadowOpInfo* info,
                       InfluenceList* res, ShadowValue** args,
                       Bool flagged);
 InfluenceList cloneInfluences(InfluenceList influences);
+InfluenceList cachedMergeInfluences(InfluenceList il1, InfluenceList il2,
+                                    ShadowOpInfo* extra);
+void printInfluenceCacheStats(void);
 void inPlaceMergeInfluences(InfluenceList* dest, InfluenceList arg);
 void dedupAddInfluenceToList(InfluenceList* influences,
                              ShadowOpInfo* influence);
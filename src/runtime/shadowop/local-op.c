@@ -35,8 +35,8 @@
 #include "../../options.h"
 #include "pub_tool_libcprint.h"
 
-double execLocalOp(ShadowOpInfo* info, Real realVal,
-                   ShadowValue* res, ShadowValue** args){
+ULong execLocalOp(ShadowOpInfo* info, Real realVal,
+                  ShadowValue* res, ShadowValue** args){
   if (no_reals) return 0;
   int nargs = numFloatArgs(info);
   double exactRoundedArgs[4];
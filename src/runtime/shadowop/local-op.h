@@ -34,7 +34,7 @@
 #include "../value-shadowstate/shadowval.h"
 #include "../op-shadowstate/shadowop-info.h"
 
-double execLocalOp(ShadowOpInfo* info, Real realVal,
-                   ShadowValue* res, ShadowValue** args);
+ULong execLocalOp(ShadowOpInfo* info, Real realVal,
+                  ShadowValue* res, ShadowValue** args);
 
 #endif
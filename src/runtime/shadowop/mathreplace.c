@@ -49,12 +49,37 @@
 #include "mpc.h"
 
 #define NCALLFRAMES 5
-#define MAX_WRAPPED_ARGS 3
 
-void performWrappedOp(OpType type, double* resLoc, double* args){
+WrappedOpCacheEntry wrappedOpCache[WRAPPED_OP_CACHE_SIZE];
+WrappedResultCacheEntry wrappedResultCache[WRAPPED_RESULT_CACHE_SIZE];
+ULong wrappedResultCacheHits = 0;
+ULong wrappedResultCacheMisses = 0;
+
+Addr wrappedCallAddr(Addr returnAddr){
+  // Stack traces give us the address just before the return address
+  // for calling frames, so that it's inside the call instruction. Do
+  // the same here so the op gets the same address either way.
+  return returnAddr == 0 ? getCallAddr() : returnAddr - 1;
+}
+
+void performWrappedOp(OpType type, double* resLoc, double* args,
+                      Addr returnAddr){
+  performWrappedOpAtCall(type, resLoc, args, wrappedCallAddr(returnAddr));
+}
+
+void performWrappedOpAtCall(OpType type, double* resLoc, double* args,
+                            Addr callAddr){
 #ifndef USE_MPFR
   tl_assert2(0, "Can't wrap math ops in GMP mode!\n");
 #endif
+  // Outside of a region nothing is shadowed, so just run the op
+  // natively. Clear any shadow left on the result from an earlier
+  // region, since the client value there is changing.
+  if (!(RUNNING || always_on)){
+    *resLoc = runEmulatedWrappedOp(type, args);
+    removeMemShadow((UWord)(uintptr_t)resLoc);
+    return;
+  }
   int nargs = getWrappedNumArgs(type);
   ValueType op_precision = getWrappedPrecision(type);
   ShadowValue* shadowArgs[MAX_WRAPPED_ARGS];
@@ -86,21 +111,20 @@ void performWrappedOp(OpType type, double* resLoc, double* args){
   removeMemShadow((UWord)(uintptr_t)resLoc);
   addMemShadow((UWord)(uintptr_t)resLoc, shadowResult);
 
-  Addr callAddr = getCallAddr();
   ShadowOpInfo* info = getWrappedOpInfo(callAddr, type, nargs);
   if (print_errors_long || print_errors){
     printOpInfo(info);
     VG_(printf)(":\n");
   }
-  double bitsGlobalError =
+  ULong ulpsGlobalError =
     updateError(&(info->agg.global_error), shadowResult->real, *resLoc);
   execSymbolicOp(info, &(shadowResult->expr),
                  *resLoc, shadowArgs,
-                 bitsGlobalError > error_threshold);
-  double bitsLocalError =
+                 ulpsGlobalError >= error_exceeds_threshold_ulps);
+  ULong ulpsLocalError =
     execLocalOp(info, shadowResult->real, shadowResult, shadowArgs);
   execInfluencesOp(info, &(shadowResult->influences), shadowArgs,
-                   bitsLocalError >= error_threshold);
+                   ulpsLocalError >= error_threshold_ulps);
   if (print_influences){
     VG_(printf)("Propagating influences for op ");
     printOpInfo(info);
@@ -136,6 +160,12 @@ void performWrappedOp(OpType type, double* resLoc, double* args){
 }
 
 ShadowOpInfo* getWrappedOpInfo(Addr callAddr, OpType opType, int nargs){
+  WrappedOpCacheEntry* cached =
+    &(wrappedOpCache[((callAddr >> 2) ^ opType) % WRAPPED_OP_CACHE_SIZE]);
+  if (cached->info != NULL && cached->callAddr == callAddr &&
+      cached->type == opType){
+    return cached->info;
+  }
   MrOpInfoEntry key = {.call_addr = callAddr, .type = opType};
   MrOpInfoEntry* entry =
     VG_(HT_gen_lookup)(mathreplaceOpInfoMap, &key, cmp_op_entry_by_type);
@@ -149,6 +179,9 @@ ShadowOpInfo* getWrappedOpInfo(Addr callAddr, OpType opType, int nargs){
     entry->type = opType;
     VG_(HT_add_node)(mathreplaceOpInfoMap, entry);
   }
+  cached->callAddr = callAddr;
+  cached->type = opType;
+  cached->info = entry->info;
   return entry->info;
 }
 
@@ -205,6 +238,31 @@ const char* getWrappedName(OpType type){
 ShadowValue* runWrappedShadowOp(OpType type, ShadowValue** shadowArgs){
   ShadowValue* result = mkShadowValueBare(getWrappedPrecision(type));
   if (no_reals) return result;
+  int nargs = getWrappedNumArgs(type);
+  WrappedResultCacheEntry* cached =
+    getWrappedResultCacheEntry(type, shadowArgs, nargs);
+  if (cached->type == type){
+    Bool argsMatch = True;
+    for(int i = 0; i < nargs && argsMatch; ++i){
+      argsMatch = realsIdentical(cached->args[i], shadowArgs[i]->real);
+    }
+    if (argsMatch){
+      wrappedResultCacheHits++;
+      copyReal(cached->result, result->real);
+      return result;
+    }
+  }
+  wrappedResultCacheMisses++;
+  // Transcendentals can be evaluated at a lower precision than the
+  // rest of the shadow values, since that's where almost all of the
+  // time goes. MPFR still rounds them correctly to that precision.
+  mpfr_ptr dest = result->real->RVAL;
+  mpfr_t lowPrecResult;
+  Int opPrecision = getWrappedOpPrecision(type);
+  if (opPrecision < precision){
+    mpfr_init2(lowPrecResult, opPrecision);
+    dest = lowPrecResult;
+  }
   switch(type){
   case OP_CDIVR:
   case OP_CDIVI:
@@ -338,7 +396,7 @@ ShadowValue* runWrappedShadowOp(OpType type, ShadowValue** shadowArgs){
 
       GET_UNARY_OPS_ROUND_F(mpfr_func, type);
 
-      mpfr_func(result->real->RVAL,
+      mpfr_func(dest,
                 shadowArgs[0]->real->RVAL, MPFR_RNDN);
     }
     break;
@@ -347,7 +405,7 @@ ShadowValue* runWrappedShadowOp(OpType type, ShadowValue** shadowArgs){
       int (*mpfr_func)(mpfr_t, mpfr_srcptr);
       GET_UNARY_OPS_NOROUND_F(mpfr_func, type);
 
-      mpfr_func(result->real->RVAL, shadowArgs[0]->real->RVAL);
+      mpfr_func(dest, shadowArgs[0]->real->RVAL);
     }
     break;
   case BINARY_OPS_CASES:
@@ -355,7 +413,7 @@ ShadowValue* runWrappedShadowOp(OpType type, ShadowValue** shadowArgs){
       int (*mpfr_func)(mpfr_t, mpfr_srcptr, mpfr_srcptr, mpfr_rnd_t);
       GET_BINARY_OPS_F(mpfr_func, type);
 
-      mpfr_func(result->real->RVAL,
+      mpfr_func(dest,
                 shadowArgs[0]->real->RVAL,
                 shadowArgs[1]->real->RVAL, MPFR_RNDN);
     }
@@ -365,7 +423,7 @@ ShadowValue* runWrappedShadowOp(OpType type, ShadowValue** shadowArgs){
       int (*mpfr_func)(mpfr_t, mpfr_srcptr, mpfr_srcptr, mpfr_srcptr, mpfr_rnd_t);
       GET_TERNARY_OPS_F(mpfr_func, type);
 
-      mpfr_func(result->real->RVAL,
+      mpfr_func(dest,
                 shadowArgs[0]->real->RVAL,
                 shadowArgs[1]->real->RVAL,
                 shadowArgs[2]->real->RVAL,
@@ -376,9 +434,67 @@ ShadowValue* runWrappedShadowOp(OpType type, ShadowValue** shadowArgs){
     tl_assert(0);
     return NULL;
   }
+  if (opPrecision < precision){
+    mpfr_set(result->real->RVAL, dest, MPFR_RNDN);
+    mpfr_clear(lowPrecResult);
+  }
+  if (cached->result == NULL){
+    cached->result = mkReal();
+    for(int i = 0; i < MAX_WRAPPED_ARGS; ++i){
+      cached->args[i] = mkReal();
+    }
+  }
+  cached->type = type;
+  for(int i = 0; i < nargs; ++i){
+    copyReal(shadowArgs[i]->real, cached->args[i]);
+  }
+  copyReal(result->real, cached->result);
   return result;
 }
 
+Int getWrappedOpPrecision(OpType type){
+  switch(type){
+  case TRANSCENDENTAL_OPS_CASES:
+    if (transcendental_precision > 0 &&
+        transcendental_precision < precision){
+      return transcendental_precision;
+    }
+    return precision;
+  default:
+    return precision;
+  }
+}
+
+WrappedResultCacheEntry* getWrappedResultCacheEntry(OpType type,
+                                                    ShadowValue** shadowArgs,
+                                                    int nargs){
+  // The double approximations are good enough to spread entries
+  // around; the exact values get compared on lookup.
+  UWord hash = type;
+  for(int i = 0; i < nargs; ++i){
+    union {
+      double d;
+      UWord w;
+    } approx;
+    approx.d = getDouble(shadowArgs[i]->real);
+    hash = hash * 31 + approx.w;
+  }
+  hash ^= hash >> (sizeof(UWord) * 4);
+  return &(wrappedResultCache[(hash ^ (hash >> 12)) &
+                              (WRAPPED_RESULT_CACHE_SIZE - 1)]);
+}
+
+void printWrappedResultCacheStats(void){
+  ULong lookups = wrappedResultCacheHits + wrappedResultCacheMisses;
+  VG_(printf)("Wrapped math result cache: %llu hits, %llu misses",
+              wrappedResultCacheHits, wrappedResultCacheMisses);
+  if (lookups > 0){
+    VG_(printf)(" (%llu%% hit rate)",
+                wrappedResultCacheHits * 100 / lookups);
+  }
+  VG_(printf)("\n");
+}
+
 double runEmulatedWrappedOp(OpType type, double* args){
   double result;
   switch(type){
@@ -399,26 +515,61 @@ Word cmp_op_entry_by_type(const void* node1, const void* node2){
 }
 
 void performSpecialWrappedOp(SpecialOpType type, double* args,
-                             double* res1, double* res2){
+                             double* res1, double* res2,
+                             Addr returnAddr){
 #ifndef USE_MPFR
   tl_assert2(0, "Can't wrap math ops in GMP mode!\n");
 #endif
   switch(type){
   case OP_SINCOS:
-    performWrappedOp(OP_SIN, res1, args);
-    performWrappedOp(OP_COS, res2, args);
+    performWrappedOp(OP_SIN, res1, args, returnAddr);
+    performWrappedOp(OP_COS, res2, args, returnAddr);
     break;
   case OP_SINCOSF:
-    performWrappedOp(OP_SINF, res1, args);
-    performWrappedOp(OP_COSF, res2, args);
+    performWrappedOp(OP_SINF, res1, args, returnAddr);
+    performWrappedOp(OP_COSF, res2, args, returnAddr);
     break;
   case OP_MODF:
-    performWrappedOp(OP_REMAINDER, res1, args);
-    performWrappedOp(OP_RINT, res2, args);
+    performWrappedOp(OP_REMAINDER, res1, args, returnAddr);
+    performWrappedOp(OP_RINT, res2, args, returnAddr);
     break;
   case OP_MODFF:
-    performWrappedOp(OP_REMAINDERF, res1, args);
-    performWrappedOp(OP_RINTF, res2, args);
+    performWrappedOp(OP_REMAINDERF, res1, args, returnAddr);
+    performWrappedOp(OP_RINTF, res2, args, returnAddr);
     break;
   }
 }
+
+void performWrappedOpBatch(HerbgrindOpRecord* records, int nrecords,
+                           Addr returnAddr){
+  Addr callAddr = wrappedCallAddr(returnAddr);
+  for(int i = 0; i < nrecords; ++i){
+    performWrappedOpAtCall((OpType)records[i].op, records[i].result,
+                           records[i].args, callAddr);
+  }
+}
+void performWrappedVectorOp(OpType type, int nlanes,
+                            double* resLocs, double* args,
+                            Addr returnAddr){
+  Addr callAddr = wrappedCallAddr(returnAddr);
+  int nargs = getWrappedNumArgs(type);
+  for(int i = 0; i < nlanes; ++i){
+    performWrappedOpAtCall(type, &(resLocs[i]), &(args[i * nargs]),
+                           callAddr);
+  }
+}
+void performWrappedVectorOpF(OpType type, int nlanes,
+                             float* resLocs, float* args,
+                             Addr returnAddr){
+  Addr callAddr = wrappedCallAddr(returnAddr);
+  int nargs = getWrappedNumArgs(type);
+  for(int i = 0; i < nlanes; ++i){
+    double double_args[MAX_WRAPPED_ARGS];
+    double double_result;
+    for(int j = 0; j < nargs; ++j){
+      double_args[j] = args[i * nargs + j];
+    }
+    performWrappedOpAtCall(type, &double_result, double_args, callAddr);
+    resLocs[i] = double_result;
+  }
+}
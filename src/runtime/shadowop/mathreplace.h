@@ -36,16 +36,70 @@
 #include "../../include/mathreplace-funcs.h"
 #include "../op-shadowstate/shadowop-info.h"
 
-void performWrappedOp(OpType type, double* args, double* resLoc);
+// A small direct-mapped cache in front of the wrapped op info hash
+// table, since the same few call sites tend to get hit over and over.
+#define WRAPPED_OP_CACHE_SIZE 1024
+
+// Complex ternary ops take three real and three imaginary parts.
+#define MAX_WRAPPED_ARGS 6
+
+// Evaluating transcendentals at high precision is by far the most
+// expensive thing we do, and programs often call them on the same
+// inputs over and over, so we remember the shadow results of recent
+// wrapped ops, keyed on the op and the exact values of its shadow
+// arguments. Must be a power of two.
+#define WRAPPED_RESULT_CACHE_SIZE 1024
+
+typedef struct _wrappedResultCacheEntry {
+  OpType type;
+  Real args[MAX_WRAPPED_ARGS];
+  Real result;
+} WrappedResultCacheEntry;
+
+typedef struct _wrappedOpCacheEntry {
+  Addr callAddr;
+  OpType type;
+  ShadowOpInfo* info;
+} WrappedOpCacheEntry;
+
+// returnAddr is the return address of the wrapped call, or zero if we
+// should find the call site by walking the stack.
+void performWrappedOp(OpType type, double* resLoc, double* args,
+                      Addr returnAddr);
+// Same as above, but for a call site we've already found with
+// wrappedCallAddr.
+void performWrappedOpAtCall(OpType type, double* resLoc, double* args,
+                            Addr callAddr);
+Addr wrappedCallAddr(Addr returnAddr);
+// Performs each of the ops in records, all attributed to the same
+// call.
+void performWrappedOpBatch(HerbgrindOpRecord* records, int nrecords,
+                           Addr returnAddr);
+// Performs the op on each of nlanes lanes. The arguments for lane i
+// start at args[i * nargs], and its result goes in resLocs[i].
+void performWrappedVectorOp(OpType type, int nlanes,
+                            double* resLocs, double* args,
+                            Addr returnAddr);
+void performWrappedVectorOpF(OpType type, int nlanes,
+                             float* resLocs, float* args,
+                             Addr returnAddr);
 ShadowOpInfo* getWrappedOpInfo(Addr callAddr, OpType opType, int nargs);
 int getWrappedNumArgs(OpType type);
 ValueType getWrappedPrecision(OpType type);
 const char* getWrappedName(OpType type);
 ShadowValue* runWrappedShadowOp(OpType type, ShadowValue** shadowArgs);
+// The precision we evaluate this op's shadow at, which might be lower
+// than --precision for transcendentals.
+Int getWrappedOpPrecision(OpType type);
+WrappedResultCacheEntry* getWrappedResultCacheEntry(OpType type,
+                                                    ShadowValue** shadowArgs,
+                                                    int nargs);
+void printWrappedResultCacheStats(void);
 double runEmulatedWrappedOp(OpType type, double* args);
 Word cmp_op_entry_by_type(const void* node1, const void* node2);
 
 void performSpecialWrappedOp(SpecialOpType type, double* args,
-                             double* res1, double* res2);
+                             double* res1, double* res2,
+                             Addr returnAddr);
 
 #endif
@@ -192,10 +192,12 @@ void ppInfluenceAddrs(ShadowValue* val);
 void ppInfluenceAddrs(ShadowValue* val){
   tl_assert(val != NULL);
   InfluenceList list = val->influences;
-  if (list != NULL && list->length > 0){
-    VG_(printf)("%lX", list->data[0]->op_addr);
-    for(int i = 1; i < list->length; ++i){
-      VG_(printf)(", and %lX", list->data[i]->op_addr);
+  int id = nextInfluenceId(list, -1);
+  if (id >= 0){
+    VG_(printf)("%lX", influenceInfos[id]->op_addr);
+    for(id = nextInfluenceId(list, id); id >= 0;
+        id = nextInfluenceId(list, id)){
+      VG_(printf)(", and %lX", influenceInfos[id]->op_addr);
     }
   }
 }
@@ -274,15 +276,15 @@ ShadowValue* executeChannelShadowOp(ShadowOpInfo* opinfo,
   if (print_errors_long || print_errors){
     VG_(printf)("Local:\n");
   }
-  double bitsLocalError =
+  ULong ulpsLocalError =
     execLocalOp(opinfo, result->real, result, args);
   if (print_errors_long || print_errors){
     VG_(printf)("Global:\n");
   }
-  double bitsGlobalError =
+  ULong ulpsGlobalError =
     updateError(&(opinfo->agg.global_error), result->real, clientResult);
   execSymbolicOp(opinfo, &(result->expr), clientResult, args,
-                 bitsGlobalError > error_threshold);
+                 ulpsGlobalError >= error_exceeds_threshold_ulps);
   if (print_expr_refs){
     VG_(printf)("Making new expression %p for value %p with 1 references.\n",
                 result->expr, result);
@@ -342,7 +344,7 @@ ShadowValue* executeChannelShadowOp(ShadowOpInfo* opinfo,
     }
   }
   execInfluencesOp(opinfo, &(result->influences), args,
-                   bitsLocalError >= error_threshold);
+                   ulpsLocalError >= error_threshold_ulps);
   if (print_influences){
     VG_(printf)("Propagating influences for op ");
     printOpInfo(opinfo);
@@ -36,6 +36,7 @@
 #include "../../helper/runtime-util.h"
 
 #define GENERALIZE_DEPTH 2
+#define STABLE_MERGES_TO_CONVERGE 16
 
 void execSymbolicOp(ShadowOpInfo* opinfo, ConcExpr** result,
                     double computedResult, ShadowValue** args,
@@ -79,18 +80,28 @@ void generalizeSymbolicExpr(SymbExpr** symbexpr, ConcExpr* cexpr){
         mkFreshSymbolicLeaf((*symbexpr)->isConst &&
                             (*symbexpr)->constVal == cexpr->value,
                             (*symbexpr)->constVal);
+    } else if ((*symbexpr)->type == Node_Branch &&
+               (*symbexpr)->branch.fingerprint != NULL &&
+               fingerprintMatches(*symbexpr, cexpr)){
+      // The expression has converged, and nothing in this concrete
+      // expression would change it, so skip the full merge.
+      (*symbexpr)->branch.stableMerges++;
     } else {
+      Bool changed = False;
       if ((*symbexpr)->isConst){
         if ((*symbexpr)->constVal != (*symbexpr)->constVal){
           (*symbexpr)->constVal = cexpr->value;
+          changed = True;
         } else if (!NaNSafeEquals((*symbexpr)->constVal, cexpr->value) &&
                    cexpr->value == cexpr->value){
           (*symbexpr)->isConst = False;
+          changed = True;
         }
       }
-      generalizeStructure(*symbexpr, cexpr, GENERALIZE_DEPTH);
+      changed |= generalizeStructure(*symbexpr, cexpr, GENERALIZE_DEPTH);
       if ((*symbexpr)->type == Node_Branch){
-        intersectEqualities(*symbexpr, cexpr);
+        changed |= intersectEqualities(*symbexpr, cexpr);
+        updateConvergence(*symbexpr, changed);
       }
     }
     if (print_expr_updates){
@@ -101,52 +112,104 @@ void generalizeSymbolicExpr(SymbExpr** symbexpr, ConcExpr* cexpr){
   }
 }
 
-void addValEntry(VgHashTable* valmap, double val, int groupIdx){
-  ValMapEntry* entry = VG_(malloc)("val map entry", sizeof(ValMapEntry));
-  entry->valHash = hashValue(val);
-  entry->val = val;
-  entry->groupIdx = groupIdx;
-  VG_(HT_add_node)(valmap, entry);
+// A small open addressing table from values to group indices, used
+// to split equivalence groups. It's reset between uses by bumping
+// the stamp rather than clearing it, and only ever grows, so once
+// it's big enough for the largest expression we see it stops
+// allocating.
+ValScratchEntry* valScratch = NULL;
+SizeT valScratchCapacity = 0;
+SizeT valScratchCount = 0;
+UInt valScratchStamp = 0;
+
+// Values are keyed by their bits, except that all NaNs share a key,
+// to agree with the NaNSafeEquals check against the canonical value.
+ULong valScratchKey(double val){
+  if (val != val){
+    return 0x7ff8000000000000ULL;
+  }
+  return *(ULong*)&val;
 }
-int lookupVal(VgHashTable* valmap, double val){
-  ValMapEntry key = {.val = val,
-                     .valHash = hashValue(val)};
-  ValMapEntry* entry = VG_(HT_gen_lookup)(valmap, &key, cmp_value);
-  if (entry == NULL){
-    return -1;
-  } else {
-    return entry->groupIdx;
+SizeT valScratchSlot(ULong key){
+  return (SizeT)((key * 0x9E3779B97F4A7C15ULL) >> 32) &
+    (valScratchCapacity - 1);
+}
+void resetValScratch(void){
+  if (valScratch == NULL){
+    valScratchCapacity = INITIAL_VAL_SCRATCH_CAPACITY;
+    valScratch = VG_(malloc)("val scratch table",
+                             sizeof(ValScratchEntry) * valScratchCapacity);
+    VG_(memset)(valScratch, 0, sizeof(ValScratchEntry) * valScratchCapacity);
+  }
+  valScratchStamp++;
+  valScratchCount = 0;
+  if (valScratchStamp == 0){
+    // The stamp wrapped, so old entries could look current.
+    VG_(memset)(valScratch, 0, sizeof(ValScratchEntry) * valScratchCapacity);
+    valScratchStamp = 1;
   }
 }
-UWord hashValue(double val){
-  return *(UWord*)&val;
+int lookupValScratch(double val){
+  ULong key = valScratchKey(val);
+  for(SizeT slot = valScratchSlot(key);
+      valScratch[slot].stamp == valScratchStamp;
+      slot = (slot + 1) & (valScratchCapacity - 1)){
+    if (valScratch[slot].key == key){
+      return valScratch[slot].groupIdx;
+    }
+  }
+  return -1;
 }
-Word cmp_value(const void* node1, const void* node2){
-  const ValMapEntry* entry1 = (const ValMapEntry*)node1;
-  const ValMapEntry* entry2 = (const ValMapEntry*)node2;
-  if (entry1->val == entry2->val){
-    return 0;
-  } else {
-    return 1;
+void insertValScratch(ULong key, int groupIdx){
+  SizeT slot = valScratchSlot(key);
+  while(valScratch[slot].stamp == valScratchStamp){
+    slot = (slot + 1) & (valScratchCapacity - 1);
   }
+  valScratch[slot].key = key;
+  valScratch[slot].groupIdx = groupIdx;
+  valScratch[slot].stamp = valScratchStamp;
+  valScratchCount++;
+}
+void addValScratch(double val, int groupIdx){
+  if ((valScratchCount + 1) * 2 > valScratchCapacity){
+    ValScratchEntry* oldEntries = valScratch;
+    SizeT oldCapacity = valScratchCapacity;
+    UInt oldStamp = valScratchStamp;
+    valScratchCapacity *= 2;
+    valScratch = VG_(malloc)("val scratch table",
+                             sizeof(ValScratchEntry) * valScratchCapacity);
+    VG_(memset)(valScratch, 0, sizeof(ValScratchEntry) * valScratchCapacity);
+    valScratchStamp = 1;
+    valScratchCount = 0;
+    for(SizeT i = 0; i < oldCapacity; ++i){
+      if (oldEntries[i].stamp == oldStamp){
+        insertValScratch(oldEntries[i].key, oldEntries[i].groupIdx);
+      }
+    }
+    VG_(free)(oldEntries);
+  }
+  insertValScratch(valScratchKey(val), groupIdx);
 }
 
-void generalizeStructure(SymbExpr* symbExpr, ConcExpr* concExpr,
+Bool generalizeStructure(SymbExpr* symbExpr, ConcExpr* concExpr,
                          int depth){
   if (depth == 0){
-    return;
+    return False;
   }
+  Bool changed = False;
   if (symbExpr->isConst){
     // NaN constants defer to whatever they generalize with
     if (symbExpr->constVal != symbExpr->constVal){
       symbExpr->constVal = concExpr->value;
+      changed = True;
     } else if (symbExpr->constVal != concExpr->value &&
                concExpr->value == concExpr->value){
       symbExpr->isConst = False;
+      changed = True;
     }
   }
   if (symbExpr->type == Node_Leaf){
-    return;
+    return changed;
   }
 
   tl_assert(symbExpr->type == Node_Branch);
@@ -165,28 +228,69 @@ void generalizeStructure(SymbExpr* symbExpr, ConcExpr* concExpr,
         if (!generalize_to_constant){
           symbChild->isConst = False;
         }
+        changed = True;
       }
     }
-    generalizeStructure(symbChild, concChild, depth - 1);
+    changed |= generalizeStructure(symbChild, concChild, depth - 1);
   }
+  return changed;
 }
 
-void intersectEqualities(SymbExpr* symbExpr, ConcExpr* concExpr){
+// Scratch group lists for intersectEqualities, reused across calls so
+// that merging doesn't allocate in the steady state. scratchTails
+// runs parallel to scratchGroups and holds the last node of each
+// group, so we can build groups in order.
+GroupList scratchGroups = NULL;
+GroupList scratchTails = NULL;
+
+void appendToGroup(Group* head, Group* tail, NodePos pos){
+  if (*tail == NULL){
+    lpush(Group)(head, pos);
+    *tail = *head;
+  } else {
+    lpush(Group)(&((*tail)->next), pos);
+    *tail = (*tail)->next;
+  }
+}
+// Removes duplicate positions from a group without reordering it,
+// returning the removed nodes to the list pool.
+void dedupGroupInPlace(Group* group){
+  for(Group node = *group; node != NULL; node = node->next){
+    Group* rest = &(node->next);
+    while(*rest != NULL){
+      if ((*rest)->item == node->item){
+        (void)lpop(Group)(rest);
+      } else {
+        rest = &((*rest)->next);
+      }
+    }
+  }
+}
+
+Bool intersectEqualities(SymbExpr* symbExpr, ConcExpr* concExpr){
   tl_assert(concExpr->type == Node_Branch);
   tl_assert(symbExpr->type == Node_Branch);
+  Bool changed = False;
+  if (scratchGroups == NULL){
+    scratchGroups = mkXA(GroupList)();
+    scratchTails = mkXA(GroupList)();
+  }
+  scratchGroups->size = 0;
+  scratchTails->size = 0;
   GroupList groups = symbExpr->branch.groups;
-  GroupList newGroups = mkXA(GroupList)();
   for(int i = 0; i < groups->size; i++){
     Group curGroup = groups->data[i];
     NodePos canonicalPos = curGroup->item;
     Group newCurGroup = NULL;
+    Group newCurGroupTail = NULL;
 
     double canonicalValue = 0.0;
-    VgHashTable* splitMap = NULL;
+    Bool splitting = False;
 
     while(curGroup != NULL){
       NodePos groupMemberPos = lpop(Group)(&curGroup);
       if (symbExprPosGet(symbExpr, groupMemberPos) == NULL){
+        changed = True;
         if (newCurGroup == NULL){
           if (curGroup == NULL){
             break;
@@ -207,51 +311,179 @@ void intersectEqualities(SymbExpr* symbExpr, ConcExpr* concExpr){
       double nodeValue = concExprPosGet(concExpr, groupMemberPos)->value;
       if (newCurGroup == NULL){
         canonicalValue = nodeValue;
-        lpush(Group)(&(newCurGroup), groupMemberPos);
-      } else {
-        if (!NaNSafeEquals(nodeValue, canonicalValue)){
-          if (splitMap == NULL){
-            splitMap = VG_(HT_construct)("split map.\n");
-          }
-          int splitGroup = lookupVal(splitMap, nodeValue);
-          if (splitGroup == -1){
-            Group newSplitGroup = NULL;
-            lpush(Group)(&newSplitGroup, groupMemberPos);
-            addValEntry(splitMap, nodeValue, newGroups->size);
-            XApush(GroupList)(newGroups, newSplitGroup);
-            RangeRecord* existingRange =
-              lookupRangeRecord(symbExpr->branch.varProblematicRanges,
-                                canonicalPos);
-            tl_assert(existingRange != NULL);
-            addRangeEntryCopy(symbExpr->branch.varProblematicRanges,
+        appendToGroup(&newCurGroup, &newCurGroupTail, groupMemberPos);
+      } else if (!NaNSafeEquals(nodeValue, canonicalValue)){
+        if (!splitting){
+          resetValScratch();
+          splitting = True;
+        }
+        changed = True;
+        int splitGroup = lookupValScratch(nodeValue);
+        if (splitGroup == -1){
+          splitGroup = scratchGroups->size;
+          XApush(GroupList)(scratchGroups, NULL);
+          XApush(GroupList)(scratchTails, NULL);
+          addValScratch(nodeValue, splitGroup);
+          RangeRecord* existingRange =
+            lookupRangeRecord(symbExpr->branch.varProblematicRanges,
+                              canonicalPos);
+          tl_assert(existingRange != NULL);
+          addRangeEntryCopy(symbExpr->branch.varProblematicRanges,
+                            groupMemberPos,
+                            existingRange);
+          addExampleEntryCopy(symbExpr->branch.exampleProblematicArgs,
                               groupMemberPos,
-                              existingRange);
-            addExampleEntryCopy(symbExpr->branch.exampleProblematicArgs,
-                                groupMemberPos,
-                                lookupExampleInput(symbExpr->branch
-                                                   .exampleProblematicArgs,
-                                                   canonicalPos));
-          } else {
-            lpush(Group)(&(newGroups->data[splitGroup]), groupMemberPos);
-          }
-        } else {
-          lpush(Group)(&(newCurGroup), groupMemberPos);
+                              lookupExampleInput(symbExpr->branch
+                                                 .exampleProblematicArgs,
+                                                 canonicalPos));
         }
+        appendToGroup(&(scratchGroups->data[splitGroup]),
+                      &(scratchTails->data[splitGroup]),
+                      groupMemberPos);
+      } else {
+        appendToGroup(&newCurGroup, &newCurGroupTail, groupMemberPos);
+      }
+    }
+    XApush(GroupList)(scratchGroups, newCurGroup);
+    XApush(GroupList)(scratchTails, newCurGroupTail);
+  }
+  // We've consumed every node of the old groups, so write the new
+  // ones back into the same list, dropping any that are singletons.
+  groups->size = 0;
+  for(int i = 0; i < scratchGroups->size; ++i){
+    Group newGroup = scratchGroups->data[i];
+    dedupGroupInPlace(&newGroup);
+    if (newGroup != NULL && newGroup->next != NULL){
+      XApush(GroupList)(groups, newGroup);
+    } else {
+      lfree(Group)(&newGroup);
+    }
+  }
+  return changed;
+}
+
+// Walks the part of the expression that generalizeStructure looks
+// at, recording the checks it would make. Returns False if there are
+// too many to record.
+Bool addFingerprintChecks(ExprFingerprint* fingerprint, SymbExpr* symbExpr,
+                          NodePos curPos, int depth);
+Bool addFingerprintChecks(ExprFingerprint* fingerprint, SymbExpr* symbExpr,
+                          NodePos curPos, int depth){
+  if (depth == 0){
+    return True;
+  }
+  if (symbExpr->isConst){
+    // A NaN constant takes on the next value it sees, so it hasn't
+    // converged yet.
+    if (symbExpr->constVal != symbExpr->constVal ||
+        fingerprint->numConsts == MAX_FINGERPRINT_CHECKS){
+      return False;
+    }
+    fingerprint->constPositions[fingerprint->numConsts] = curPos;
+    fingerprint->constVals[fingerprint->numConsts] = symbExpr->constVal;
+    fingerprint->numConsts++;
+  }
+  if (symbExpr->type == Node_Leaf){
+    return True;
+  }
+  for(int i = 0; i < symbExpr->branch.nargs; ++i){
+    SymbExpr* symbChild = symbExpr->branch.args[i];
+    NodePos childPos = rconsPos(curPos, i);
+    if (symbChild->type == Node_Branch){
+      if (fingerprint->numOps == MAX_FINGERPRINT_CHECKS){
+        return False;
       }
+      fingerprint->opPositions[fingerprint->numOps] = childPos;
+      fingerprint->ops[fingerprint->numOps] = symbChild->branch.op;
+      fingerprint->numOps++;
     }
-    if (splitMap != NULL){
-      VG_(HT_destruct)(splitMap, VG_(free));
+    if (!addFingerprintChecks(fingerprint, symbChild, childPos, depth - 1)){
+      return False;
     }
-    XApush(GroupList)(newGroups, newCurGroup);
   }
-  freeXA(GroupList)(symbExpr->branch.groups);
-  symbExpr->branch.groups = pruneSingletonGroups(newGroups);
+  return True;
+}
+ExprFingerprint* mkExprFingerprint(SymbExpr* symbExpr){
+  tl_assert(symbExpr->type == Node_Branch);
+  ExprFingerprint* fingerprint =
+    VG_(malloc)("expr fingerprint", sizeof(ExprFingerprint));
+  fingerprint->numOps = 0;
+  fingerprint->numConsts = 0;
+  if (!addFingerprintChecks(fingerprint, symbExpr, null_pos,
+                            GENERALIZE_DEPTH)){
+    VG_(free)(fingerprint);
+    return NULL;
+  }
+  return fingerprint;
+}
+// True if merging concExpr into symbExpr wouldn't change it. The ops
+// are recorded parents first, so by the time we look up a position
+// we've already checked that the path down to it exists.
+Bool fingerprintMatches(SymbExpr* symbExpr, ConcExpr* concExpr){
+  ExprFingerprint* fingerprint = symbExpr->branch.fingerprint;
+  for(int i = 0; i < fingerprint->numOps; ++i){
+    ConcExpr* node = concExprPosGet(concExpr, fingerprint->opPositions[i]);
+    if (node == NULL || node->type != Node_Branch ||
+        node->branch.op != fingerprint->ops[i]){
+      return False;
+    }
+  }
+  for(int i = 0; i < fingerprint->numConsts; ++i){
+    double value =
+      concExprPosGet(concExpr, fingerprint->constPositions[i])->value;
+    if (value != fingerprint->constVals[i] && value == value){
+      return False;
+    }
+  }
+  GroupList groups = symbExpr->branch.groups;
+  for(int i = 0; i < groups->size; ++i){
+    Group curGroup = groups->data[i];
+    if (curGroup == NULL){
+      continue;
+    }
+    ConcExpr* canonicalNode = concExprPosGet(concExpr, curGroup->item);
+    if (canonicalNode == NULL){
+      return False;
+    }
+    for(Group curNode = curGroup->next; curNode != NULL;
+        curNode = curNode->next){
+      ConcExpr* node = concExprPosGet(concExpr, curNode->item);
+      if (node == NULL ||
+          !NaNSafeEquals(node->value, canonicalNode->value)){
+        return False;
+      }
+    }
+  }
+  return True;
+}
+// Merging is monotone, expressions only ever get more general, so
+// after enough merges in a row that didn't change anything it's
+// worth summarizing what could change it, so that later merges can
+// just check against that. If we get here with a fingerprint, it
+// failed to match but the merge didn't change anything, which means
+// some shared subexpression got generalized under us, so rebuild it.
+void updateConvergence(SymbExpr* symbExpr, Bool changed){
+  if (changed){
+    symbExpr->branch.stableMerges = 0;
+    if (symbExpr->branch.fingerprint != NULL){
+      VG_(free)(symbExpr->branch.fingerprint);
+      symbExpr->branch.fingerprint = NULL;
+    }
+    return;
+  }
+  symbExpr->branch.stableMerges++;
+  if (symbExpr->branch.fingerprint != NULL){
+    VG_(free)(symbExpr->branch.fingerprint);
+    symbExpr->branch.fingerprint = mkExprFingerprint(symbExpr);
+  } else if (symbExpr->branch.stableMerges == STABLE_MERGES_TO_CONVERGE){
+    symbExpr->branch.fingerprint = mkExprFingerprint(symbExpr);
+  }
 }
 
-void getGrouped(GroupList groupList, VgHashTable* valMap,
+void getGrouped(GroupList groupList,
                 ConcExpr* concExpr, SymbExpr* symbExpr,
                 NodePos curPos, int maxDepth);
-void getGrouped(GroupList groupList, VgHashTable* valMap,
+void getGrouped(GroupList groupList,
                 ConcExpr* concExpr, SymbExpr* symbExpr,
                 NodePos curPos, int maxDepth){
   tl_assert(symbExpr->type == Node_Branch);
@@ -263,12 +495,11 @@ void getGrouped(GroupList groupList, VgHashTable* valMap,
     NodePos newPos = rconsPos(curPos, i);
     double value = concChild->value;
 
-    int existingEntry =
-      lookupVal(valMap, value);
+    int existingEntry = lookupValScratch(value);
     int groupIdx;
     if (existingEntry == -1){
       groupIdx = groupList->size;
-      addValEntry(valMap, value, groupIdx);
+      addValScratch(value, groupIdx);
       Group newGroup = NULL;
       XApush(GroupList)(groupList, newGroup);
     } else {
@@ -281,7 +512,7 @@ void getGrouped(GroupList groupList, VgHashTable* valMap,
         symbChild->type == Node_Branch &&
         concChild->branch.op == symbChild->branch.op){
       if (maxDepth > 1){
-        getGrouped(groupList, valMap, concChild, symbChild, newPos, maxDepth - 1);
+        getGrouped(groupList, concChild, symbChild, newPos, maxDepth - 1);
       } else {
         for(int j = 0; j < symbChild->branch.groups->size; ++j){
           Group oldGroup = symbChild->branch.groups->data[j];
@@ -370,10 +601,9 @@ int numTrackedNodes(GroupList glist){
 int groupsGetTimes=0;
 GroupList getExprsEquivGroups(ConcExpr* concExpr, SymbExpr* symbExpr){
   GroupList groupList = mkXA(GroupList)();
-  VgHashTable* valMap = VG_(HT_construct)("val map");
-  getGrouped(groupList, valMap, concExpr, symbExpr,
+  resetValScratch();
+  getGrouped(groupList, concExpr, symbExpr,
              null_pos, max_expr_block_depth);
-  VG_(HT_destruct)(valMap, VG_(free));
   GroupList prunedGroups = pruneSingletonGroups(groupList);
   return prunedGroups;
 }
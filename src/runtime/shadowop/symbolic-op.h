@@ -45,12 +45,12 @@ typedef struct _varMapEntry {
   UWord varIdx;
 } VarMapEntry;
 
-typedef struct _valMapEntry {
-  struct _valMapEntry* next;
-  UWord valHash;
-  double val;
-  UWord groupIdx;
-} ValMapEntry;
+typedef struct _valScratchEntry {
+  ULong key;
+  int groupIdx;
+  UInt stamp;
+} ValScratchEntry;
+#define INITIAL_VAL_SCRATCH_CAPACITY 64
 
 typedef struct _rangeMapEntry {
   struct _rangeMapEntry* next;
@@ -65,14 +65,37 @@ typedef struct _exampleMapEntry {
   double value;
 } ExampleMapEntry;
 
+// The most positions a fingerprint can check, for each kind of
+// check. With GENERALIZE_DEPTH at 2 we need at most
+// MAX_BRANCH_ARGS + MAX_BRANCH_ARGS^2 op checks.
+#define MAX_FINGERPRINT_CHECKS 32
+// Once a symbolic expression has stopped changing, this records
+// everything about a new concrete expression that could still change
+// it: which ops have to appear where, and which constants have to
+// keep their values. The equivalence groups are checked directly
+// off the expression.
+struct _ExprFingerprint {
+  int numOps;
+  NodePos opPositions[MAX_FINGERPRINT_CHECKS];
+  ShadowOpInfo* ops[MAX_FINGERPRINT_CHECKS];
+  int numConsts;
+  NodePos constPositions[MAX_FINGERPRINT_CHECKS];
+  double constVals[MAX_FINGERPRINT_CHECKS];
+};
+
 void execSymbolicOp(ShadowOpInfo* opinfo, ConcExpr** result,
                     double computedResult, ShadowValue** args,
                     Bool problematic);
 void generalizeSymbolicExpr(SymbExpr** symexpr, ConcExpr* cexpr);
 
-void generalizeStructure(SymbExpr* symbexpr, ConcExpr* concExpr,
+// These return True if they changed the symbolic expression.
+Bool generalizeStructure(SymbExpr* symbexpr, ConcExpr* concExpr,
                          int depth);
-void intersectEqualities(SymbExpr* symbexpr, ConcExpr* concExpr);
+Bool intersectEqualities(SymbExpr* symbexpr, ConcExpr* concExpr);
+
+ExprFingerprint* mkExprFingerprint(SymbExpr* symbExpr);
+Bool fingerprintMatches(SymbExpr* symbExpr, ConcExpr* concExpr);
+void updateConvergence(SymbExpr* symbExpr, Bool changed);
 GroupList getExprsEquivGroups(ConcExpr* concExpr, SymbExpr* symbExpr);
 GroupList dedupGroups(GroupList list);
 GroupList pruneSingletonGroups(GroupList list);
@@ -83,10 +106,9 @@ VarMap* mkVarMap(GroupList groups);
 int lookupVar(VarMap* map, NodePos pos);
 void freeVarMap(VarMap* map);
 
-void addValEntry(VgHashTable* valmap, double val, int groupIdx);
-int lookupVal(VgHashTable* valmap, double val);
-UWord hashValue(double val);
-Word cmp_value(const void* node1, const void* node2);
+void resetValScratch(void);
+int lookupValScratch(double val);
+void addValScratch(double val, int groupIdx);
 
 ConcExpr* concExprPosGet(ConcExpr* expr, NodePos pos);
 SymbExpr* symbExprPosGet(SymbExpr* expr, NodePos pos);
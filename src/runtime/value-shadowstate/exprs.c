@@ -45,6 +45,8 @@
 
 Stack* leafCExprs;
 Stack* branchCExprs[MAX_BRANCH_ARGS];
+ConcExpr** concExprTable = NULL;
+SizeT concExprTableSize = 0;
 Xarray_H(Stack*, StackArray);
 Xarray_Impl(Stack*, StackArray);
 Xarray_H(char*, VarList);
@@ -65,41 +67,189 @@ void initExprAllocator(void){
   }
   extraVars = mkXA(VarList)();
   initializePositionTree();
+  concExprTableSize = INITIAL_CEXPR_TABLE_SIZE;
+  concExprTable = VG_(calloc)("expr hash-cons table",
+                              concExprTableSize, sizeof(ConcExpr*));
 }
 VG_REGPARM(1) void freeBranchConcExpr(ConcExpr* expr){
   stack_push(branchCExprs[expr->branch.nargs - 1], (void*)expr);
 }
-void recursivelyDisownConcExpr(ConcExpr* expr, int depth){
-  if (depth == 0) return;
-  tl_assert2(expr->ref_count > 0,
-             "The ref count of %p is already zero, and we're trying to decrease it!\n",
-             expr);
-  if (print_expr_refs){
-    VG_(printf)("Decreasing ref count of expr %p from %d to %d\n",
-                expr, expr->ref_count, expr->ref_count - 1);
+// Leaves are hashed with a NULL op and no arguments.
+UWord hashConcExpr(double value, ShadowOpInfo* op, int nargs, ConcExpr** args){
+  UWord hash = *(UWord*)&value;
+  hash = hash * 31 + (UWord)op;
+  for(int i = 0; i < nargs; ++i){
+    hash = hash * 31 + (UWord)args[i];
   }
-  (expr->ref_count)--;
-  if (expr->ref_count == 0){
-    if (print_expr_refs){
-      VG_(printf)("No references left for expr %p! Freeing...\n", expr);
+  return hash;
+}
+UWord hashExistingConcExpr(ConcExpr* expr);
+UWord hashExistingConcExpr(ConcExpr* expr){
+  if (expr->type == Node_Leaf){
+    return hashConcExpr(expr->value, NULL, 0, NULL);
+  } else {
+    return hashConcExpr(expr->value, expr->branch.op,
+                        expr->branch.nargs, expr->branch.args);
+  }
+}
+ConcExpr* lookupConcExpr(UWord hash, double value, ShadowOpInfo* op,
+                         int nargs, ConcExpr** args){
+  for(ConcExpr* entry = concExprTable[hash % concExprTableSize];
+      entry != NULL;
+      entry = entry->hashNext){
+    // Compare values bitwise, so that NaNs match and zeroes of
+    // different sign don't.
+    if (*(UWord*)&(entry->value) != *(UWord*)&value){
+      continue;
     }
-    if (expr->type == Node_Leaf){
-      stack_push(leafCExprs, (void*)expr);
-    } else {
-      freeBranchConcExpr(expr);
+    if (op == NULL){
+      if (entry->type == Node_Leaf){
+        return entry;
+      }
+      continue;
+    }
+    if (entry->type != Node_Branch ||
+        entry->branch.op != op ||
+        entry->branch.nargs != nargs){
+      continue;
+    }
+    Bool argsMatch = True;
+    for(int i = 0; i < nargs; ++i){
+      if (entry->branch.args[i] != args[i]){
+        argsMatch = False;
+        break;
+      }
+    }
+    if (argsMatch){
+      return entry;
     }
   }
+  return NULL;
+}
+// Expression nodes aren't reference counted through their parents,
+// since that would either keep whole program histories alive or
+// (as we used to do) require walking max_expr_block_depth * 2 levels
+// of the tree on every own and disown. Instead, ref_count only counts
+// the shadow values that point directly at a node, which makes owning
+// and disowning constant time. Every so often we sweep the hash-cons
+// table, keeping everything within max_expr_block_depth * 2 levels
+// of a node with a nonzero ref count, and freeing the rest. That's
+// the same window the old scheme kept alive, so anything that only
+// walks that far down from a shadow value's expression is safe.
+UInt exprEpoch = 0;
+SizeT numLiveConcExprs = 0;
+SizeT exprSweepThreshold = MIN_EXPR_SWEEP_THRESHOLD;
+
+void markConcExpr(ConcExpr* expr, int depth){
+  if (depth == 0) return;
+  // If we've already marked this node from somewhere at least this
+  // close to a root, everything we'd mark below it is marked too.
+  if (expr->markEpoch == exprEpoch && expr->markDepth >= depth) return;
+  expr->markEpoch = exprEpoch;
+  expr->markDepth = depth;
   if (expr->type == Node_Branch){
     for(int i = 0; i < expr->branch.nargs; ++i){
-      recursivelyDisownConcExpr(expr->branch.args[i], depth - 1);
+      markConcExpr(expr->branch.args[i], depth - 1);
+    }
+  }
+}
+void sweepConcExprs(void){
+  exprEpoch++;
+  for(SizeT i = 0; i < concExprTableSize; ++i){
+    for(ConcExpr* entry = concExprTable[i]; entry != NULL;
+        entry = entry->hashNext){
+      if (entry->ref_count > 0){
+        markConcExpr(entry, max_expr_block_depth * 2);
+      }
     }
   }
+  for(SizeT i = 0; i < concExprTableSize; ++i){
+    ConcExpr** entry = &(concExprTable[i]);
+    while(*entry != NULL){
+      ConcExpr* expr = *entry;
+      if (expr->markEpoch == exprEpoch){
+        entry = &(expr->hashNext);
+        continue;
+      }
+      if (print_expr_refs){
+        VG_(printf)("Expr %p is out of reach! Freeing...\n", expr);
+      }
+      *entry = expr->hashNext;
+      numLiveConcExprs--;
+      if (expr->type == Node_Leaf){
+        stack_push(leafCExprs, (void*)expr);
+      } else {
+        freeBranchConcExpr(expr);
+      }
+    }
+  }
+  exprSweepThreshold = numLiveConcExprs * 2;
+  if (exprSweepThreshold < MIN_EXPR_SWEEP_THRESHOLD){
+    exprSweepThreshold = MIN_EXPR_SWEEP_THRESHOLD;
+  }
+}
+void maybeSweepConcExprs(void){
+  if (numLiveConcExprs >= exprSweepThreshold){
+    sweepConcExprs();
+  }
+}
+void growConcExprTable(void);
+void growConcExprTable(void){
+  SizeT newSize = concExprTableSize * 2 + 1;
+  ConcExpr** newTable = VG_(calloc)("expr hash-cons table",
+                                    newSize, sizeof(ConcExpr*));
+  for(SizeT i = 0; i < concExprTableSize; ++i){
+    ConcExpr* entry = concExprTable[i];
+    while(entry != NULL){
+      ConcExpr* next = entry->hashNext;
+      UWord bucket = hashExistingConcExpr(entry) % newSize;
+      entry->hashNext = newTable[bucket];
+      newTable[bucket] = entry;
+      entry = next;
+    }
+  }
+  VG_(free)(concExprTable);
+  concExprTable = newTable;
+  concExprTableSize = newSize;
+}
+void addConcExpr(UWord hash, ConcExpr* expr){
+  UWord bucket = hash % concExprTableSize;
+  expr->hashNext = concExprTable[bucket];
+  concExprTable[bucket] = expr;
+  numLiveConcExprs++;
+  if (numLiveConcExprs > concExprTableSize){
+    growConcExprTable();
+  }
+}
+
+void ownConcExpr(ConcExpr* expr){
+  if (print_expr_refs){
+    VG_(printf)("Increasing ref count of expr %p from %d to %d\n",
+                expr, expr->ref_count, expr->ref_count + 1);
+  }
+  (expr->ref_count)++;
 }
 void disownConcExpr(ConcExpr* expr){
-  recursivelyDisownConcExpr(expr, max_expr_block_depth * 2);
+  tl_assert2(expr->ref_count > 0,
+             "The ref count of %p is already zero, and we're trying to decrease it!\n",
+             expr);
+  if (print_expr_refs){
+    VG_(printf)("Decreasing ref count of expr %p from %d to %d\n",
+                expr, expr->ref_count, expr->ref_count - 1);
+  }
+  (expr->ref_count)--;
 }
 ConcExpr* mkLeafConcExpr(double value){
-  ConcExpr* result;
+  maybeSweepConcExprs();
+  UWord hash = hashConcExpr(value, NULL, 0, NULL);
+  ConcExpr* result = lookupConcExpr(hash, value, NULL, 0, NULL);
+  if (result != NULL){
+    if (print_expr_refs){
+      VG_(printf)("Sharing leaf expression %p\n", result);
+    }
+    ownConcExpr(result);
+    return result;
+  }
   if (stack_empty(leafCExprs)){
     result = VG_(malloc)("expr", sizeof(ConcExpr));
     result->type = Node_Leaf;
@@ -107,32 +257,33 @@ ConcExpr* mkLeafConcExpr(double value){
     result = (void*)stack_pop(leafCExprs);
   }
   result->ref_count = 1;
+  // Whatever was left here from a past life can't look marked, or
+  // the next sweep would skip this node's children.
+  result->markEpoch = exprEpoch - 1;
+  result->markDepth = 0;
   if (print_expr_refs){
     VG_(printf)("Making new expression %p with 1 reference\n", result);
   }
   result->value = value;
+  addConcExpr(hash, result);
 
   return result;
 }
 
-void recursivelyOwnConcExpr(ConcExpr* expr, int depth){
-  if (depth == 0) return;
-  if (print_expr_refs){
-    VG_(printf)("Increasing ref count of expr %p from %d to %d\n",
-                expr, expr->ref_count, expr->ref_count + 1);
-  }
-  (expr->ref_count)++;
-  if (expr->type == Node_Branch){
-    for(int i = 0; i < expr->branch.nargs; ++i){
-      tl_assert(expr->branch.args[i] != NULL);
-      recursivelyOwnConcExpr(expr->branch.args[i], depth - 1);
-    }
-  }
-}
-
 ConcExpr* mkBranchConcExpr(double value, ShadowOpInfo* op,
                            int nargs, ConcExpr** args){
-  ConcExpr* result;
+  // The arguments all belong to live shadow values, so a sweep here
+  // can't take them out from under us.
+  maybeSweepConcExprs();
+  UWord hash = hashConcExpr(value, op, nargs, args);
+  ConcExpr* result = lookupConcExpr(hash, value, op, nargs, args);
+  if (result != NULL){
+    if (print_expr_refs){
+      VG_(printf)("Sharing branch expression %p\n", result);
+    }
+    ownConcExpr(result);
+    return result;
+  }
   if (stack_empty(branchCExprs[nargs-1])){
     result = VG_(malloc)("expr", sizeof(ConcExpr));
     result->branch.args = VG_(perm_malloc)(sizeof(ConcExpr*) * nargs,
@@ -142,11 +293,12 @@ ConcExpr* mkBranchConcExpr(double value, ShadowOpInfo* op,
   } else {
     result = (void*)stack_pop(branchCExprs[nargs-1]);
   }
-  // We'll do ownership stuff at the end, leave it at 0 refs for now.
   if (print_expr_refs){
-    VG_(printf)("Making new expression %p with 0 references\n", result);
+    VG_(printf)("Making new expression %p with 1 reference\n", result);
   }
-  result->ref_count = 0;
+  result->ref_count = 1;
+  result->markEpoch = exprEpoch - 1;
+  result->markDepth = 0;
   result->value = value;
   result->branch.op = op;
 
@@ -155,8 +307,7 @@ ConcExpr* mkBranchConcExpr(double value, ShadowOpInfo* op,
     tl_assert(result->branch.nargs > i);
     result->branch.args[i] = args[i];
   }
-
-  recursivelyOwnConcExpr(result, max_expr_block_depth * 2);
+  addConcExpr(hash, result);
   return result;
 }
 
@@ -219,6 +370,8 @@ SymbExpr* concreteToSymbolic(ConcExpr* cexpr){
       }
     }
     result->branch.groups = getExprsEquivGroups(cexpr, result);
+    result->branch.stableMerges = 0;
+    result->branch.fingerprint = NULL;
     initializeProblematicRangesAndExample(result);
   }
   return result;
@@ -973,9 +1126,8 @@ char* symbExprToString(SymbExpr* expr, int* numVarsOut){
   } else {
     VarMap* varMap =
       mkVarMap(groupsWithoutNonVars(expr, expr->branch.groups, MAX_FOLD_DEPTH));
-    const char* toplevel_func;
-    if (!VG_(get_fnname)(VG_(current_DiEpoch)(),
-                         expr->branch.op->op_addr, &toplevel_func)){
+    const char* toplevel_func = getFnName(expr->branch.op->op_addr);
+    if (toplevel_func[0] == '\0'){
       toplevel_func = "none";
     }
     char* _buf = VG_(malloc)("buffer data", MAX_EXPR_LEN);
@@ -1097,9 +1249,8 @@ void recursivelyToString(SymbExpr* expr, BBuf* buf, VarMap* varMap,
           SymbExpr* arg1 = expr->branch.args[1];
           tl_assert(expr->branch.nargs > 1);
           if (arg0->isConst && arg0->constVal == 0.0){
-            const char* fnname;
-            if (!(VG_(get_fnname)(VG_(current_DiEpoch)(),
-                                  expr->branch.op->op_addr, &fnname))){
+            const char* fnname = getFnName(expr->branch.op->op_addr);
+            if (fnname[0] == '\0'){
               fnname = "none";
             }
             if (VG_(strcmp)(fnname, parent_func)){
@@ -1136,8 +1287,8 @@ void recursivelyToString(SymbExpr* expr, BBuf* buf, VarMap* varMap,
     }
     printBBuf(buf, " ");
 
-    const char* fnname;
-    if (!(VG_(get_fnname)(VG_(current_DiEpoch)(), expr->branch.op->op_addr, &fnname))){
+    const char* fnname = getFnName(expr->branch.op->op_addr);
+    if (fnname[0] == '\0'){
       fnname = "none";
     }
     if (VG_(strcmp)(fnname, parent_func)){
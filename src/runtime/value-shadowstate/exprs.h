@@ -50,7 +50,16 @@ typedef enum {
 
 struct _ConcExpr {
   struct _ConcExpr* next;
+  // Chain pointer for the hash-consing table. Live expressions are
+  // shared, so two nodes with the same op, value, and argument nodes
+  // are always the same node.
+  struct _ConcExpr* hashNext;
+  // The number of shadow values pointing directly at this node. Nodes
+  // within max_expr_block_depth * 2 of a node with references are
+  // kept alive by sweepConcExprs.
   int ref_count;
+  UInt markEpoch;
+  int markDepth;
   NodeType type;
   double value;
   struct {
@@ -60,6 +69,13 @@ struct _ConcExpr {
   } branch;
 };
 
+// The hash-cons table starts with this many buckets, and doubles
+// whenever there are more live nodes than buckets.
+#define INITIAL_CEXPR_TABLE_SIZE 65521
+#define MIN_EXPR_SWEEP_THRESHOLD 65536
+extern ConcExpr** concExprTable;
+extern SizeT concExprTableSize;
+
 List_H(NodePos, Group);
 Xarray_H(Group, GroupList);
 
@@ -76,6 +92,11 @@ struct _SymbExpr {
     GroupList groups;
     VgHashTable* varProblematicRanges;
     VgHashTable* exampleProblematicArgs;
+    // How many merges in a row haven't changed this expression, and
+    // once that's high enough, a summary of the checks that could
+    // change it. See generalizeSymbolicExpr.
+    int stableMerges;
+    ExprFingerprint* fingerprint;
   } branch;
 };
 
@@ -84,13 +105,16 @@ typedef struct _varMap {
   int nextVarIdx;
 } VarMap;
 
-void recursivelyOwnConcExpr(ConcExpr* expr, int depth);
-void recursivelyDisownConcExpr(ConcExpr* expr, int depth);
+void ownConcExpr(ConcExpr* expr);
+void disownConcExpr(ConcExpr* expr);
+void sweepConcExprs(void);
 void initExprAllocator(void);
 ConcExpr* mkLeafConcExpr(double value);
 ConcExpr* mkBranchConcExpr(double value, ShadowOpInfo* op, int nargs, ConcExpr** args);
 VG_REGPARM(1) void freeBranchConcExpr(ConcExpr* expr);
-void disownConcExpr(ConcExpr* expr);
+UWord hashConcExpr(double value, ShadowOpInfo* op, int nargs, ConcExpr** args);
+ConcExpr* lookupConcExpr(UWord hash, double value, ShadowOpInfo* op,
+                         int nargs, ConcExpr** args);
 SymbExpr* mkFreshSymbolicLeaf(Bool isConst, double constVal);
 SymbExpr* concreteToSymbolic(ConcExpr* cexpr);
 
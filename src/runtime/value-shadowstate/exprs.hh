@@ -32,5 +32,6 @@
 
 typedef struct _ConcExpr ConcExpr;
 typedef struct _SymbExpr SymbExpr;
+typedef struct _ExprFingerprint ExprFingerprint;
 
 #endif
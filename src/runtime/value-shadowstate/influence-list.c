@@ -31,160 +31,335 @@
 #include "pub_tool_mallocfree.h"
 #include "pub_tool_libcassert.h"
 #include "pub_tool_libcprint.h"
+#include "pub_tool_libcbase.h"
+#include "pub_tool_hashtable.h"
 
 #include "../../options.h"
 #include "../../helper/runtime-util.h"
 
 InfluenceList pool = NULL;
+// Every live influence list is interned here, so equal sets are
+// always the same list, and lists can be shared by reference.
+VgHashTable* internedInfluences = NULL;
+// Where merges are built before being interned.
+InfluenceList scratchInfluences = NULL;
 
+ShadowOpInfo** influenceInfos = NULL;
+int numInfluenceIds = 0;
+int influenceInfosCapacity = 0;
+
+int getInfluenceId(ShadowOpInfo* info){
+  if (info->influence_id < 0){
+    if (numInfluenceIds == influenceInfosCapacity){
+      influenceInfosCapacity =
+        influenceInfosCapacity == 0 ? 64 : influenceInfosCapacity * 2;
+      influenceInfos =
+        VG_(realloc)("influence infos", influenceInfos,
+                     sizeof(ShadowOpInfo*) * influenceInfosCapacity);
+    }
+    info->influence_id = numInfluenceIds;
+    influenceInfos[numInfluenceIds++] = info;
+  }
+  return info->influence_id;
+}
+
+InfluenceList mkInfluenceList(void);
 InfluenceList mkInfluenceList(void){
   InfluenceList result;
   if (pool == NULL){
     result =
       VG_(malloc)("influence list", sizeof(struct _influenceList));
-    result->data =
-      VG_(malloc)("influence list data", sizeof(ShadowOpInfo*) * max_influences);
+    result->capacity = INFLUENCE_INLINE_WORDS;
+    result->words = result->inlineWords;
   } else {
     result = pool;
     pool = pool->next;
   }
   result->next = NULL;
-  result->length = 0;
+  result->ref_count = 0;
+  result->numWords = 0;
   return result;
 }
 
-void freeInfluenceList(InfluenceList il){
-  il->next = pool;
-  pool = il;
+// Makes room for numWords words in the list, zeroing any new ones.
+void reserveInfluenceWords(InfluenceList il, int numWords);
+void reserveInfluenceWords(InfluenceList il, int numWords){
+  if (numWords > il->capacity){
+    int newCapacity = il->capacity * 2;
+    while(newCapacity < numWords){
+      newCapacity *= 2;
+    }
+    ULong* newWords =
+      VG_(malloc)("influence list words", sizeof(ULong) * newCapacity);
+    for(int i = 0; i < il->numWords; ++i){
+      newWords[i] = il->words[i];
+    }
+    if (il->words != il->inlineWords){
+      VG_(free)(il->words);
+    }
+    il->words = newWords;
+    il->capacity = newCapacity;
+  }
+  for(int i = il->numWords; i < numWords; ++i){
+    il->words[i] = 0;
+  }
+  if (numWords > il->numWords){
+    il->numWords = numWords;
+  }
 }
 
-inline int score(ShadowOpInfo* info);
-inline int score(ShadowOpInfo* info){
-  return info->agg.local_error.max_error;
+Word cmpInfluenceLists(const void* node1, const void* node2);
+Word cmpInfluenceLists(const void* node1, const void* node2){
+  const struct _influenceList* il1 = node1;
+  const struct _influenceList* il2 = node2;
+  if (il1->numWords != il2->numWords){
+    return 1;
+  }
+  for(int i = 0; i < il1->numWords; ++i){
+    if (il1->words[i] != il2->words[i]){
+      return 1;
+    }
+  }
+  return 0;
 }
 
-InfluenceList mergeInfluences(InfluenceList il1, InfluenceList il2,
-                              ShadowOpInfo* extra){
-  if (il1 == NULL && il2 == NULL && extra == NULL) return NULL;
+// Returns an owned reference to the interned list equal to the
+// scratch list, or NULL if the scratch list is empty.
+InfluenceList internScratchInfluences(void);
+InfluenceList internScratchInfluences(void){
+  while(scratchInfluences->numWords > 0 &&
+        scratchInfluences->words[scratchInfluences->numWords - 1] == 0){
+    scratchInfluences->numWords--;
+  }
+  if (scratchInfluences->numWords == 0){
+    return NULL;
+  }
+  UWord hash = 14695981039346656037ULL;
+  for(int i = 0; i < scratchInfluences->numWords; ++i){
+    hash = (hash ^ scratchInfluences->words[i]) * 1099511628211ULL;
+  }
+  scratchInfluences->hash = hash;
+  if (internedInfluences == NULL){
+    internedInfluences = VG_(HT_construct)("interned influences");
+  }
+  InfluenceList existing =
+    VG_(HT_gen_lookup)(internedInfluences, scratchInfluences,
+                       cmpInfluenceLists);
+  if (existing != NULL){
+    return ownInfluenceList(existing);
+  }
   InfluenceList result = mkInfluenceList();
-  int i = 0;
-  int j = 0;
-  while(((il1 != NULL && i < il1->length) ||
-         (il2 != NULL && j < il2->length) ||
-         extra != NULL) &&
-        result->length < max_influences){
-    if (il1 != NULL && i < il1->length &&
-        (il2 == NULL || j >= il2->length || cmpInfo(il1->data[i], il2->data[j]) >= 0) &&
-        (extra == NULL || cmpInfo(il1->data[i], extra) >= 0)){
-      if (result->length == 0 || result->data[result->length-1] != il1->data[i]){
-        result->data[result->length++] = il1->data[i];
-      }
-      i++;
-    } else if (il2 != NULL && j < il2->length &&
-               (il1 == NULL || i >= il1->length ||
-                cmpInfo(il2->data[j], il1->data[i]) >= 0) &&
-               (extra == NULL || cmpInfo(il2->data[j], extra) >= 0)){
-      if (result->length == 0 || result->data[result->length-1] != il2->data[j]){
-        result->data[result->length++] = il2->data[j];
-      }
-      j++;
-    } else if (extra != NULL &&
-               (il1 == NULL || i >= il1->length || cmpInfo(extra, il1->data[i]) >= 0) &&
-               (il2 == NULL || j >= il2->length || cmpInfo(extra, il2->data[j]) >= 0)){
-      if (result->length == 0 || result->data[result->length-1] != extra){
-        result->data[result->length++] = extra;
-      }
-      extra = NULL;
-    } else {
-      VG_(printf)("cmpInfo(il2->data[j], il1->data[i]) : %d\n",
-                  cmpInfo(il2->data[j], il1->data[i]));
-      VG_(printf)("il2->data[j]: %p\nil1->data[i]: %p\n",
-                  il2->data[j], il1->data[i]);
-      VG_(printf)("extra: %p\n", extra);
-      VG_(printf)("i: %d, il1: %p", i, il1);
-      if (il1 != NULL){
-        VG_(printf)(" il1->length : %d", il1->length);
-      }
-      VG_(printf)("\n");
-      VG_(printf)("j: %d, il2: %p", j, il2);
-      if (il2 != NULL){
-        VG_(printf)(" il2->length : %d", il2->length);
-      }
-      VG_(printf)("\n");
-      tl_assert(0);
-    }
+  reserveInfluenceWords(result, scratchInfluences->numWords);
+  for(int i = 0; i < scratchInfluences->numWords; ++i){
+    result->words[i] = scratchInfluences->words[i];
   }
+  result->hash = hash;
+  result->ref_count = 1;
+  VG_(HT_add_node)(internedInfluences, result);
   return result;
 }
 
-void ppInfluences(InfluenceList influences){
-  if (influences == NULL){
+InfluenceList ownInfluenceList(InfluenceList il){
+  if (il != NULL){
+    il->ref_count++;
+  }
+  return il;
+}
+
+void disownInfluenceList(InfluenceList il){
+  if (il == NULL){
     return;
   }
-  for(int i = 0; i < influences->length; ++i){
-    VG_(printf)("* ");
-    printOpInfo(influences->data[i]);
-    VG_(printf)("\n");
+  tl_assert(il->ref_count > 0);
+  il->ref_count--;
+  if (il->ref_count == 0){
+    InfluenceList removed =
+      VG_(HT_gen_remove)(internedInfluences, il, cmpInfluenceLists);
+    tl_assert(removed == il);
+    il->next = pool;
+    pool = il;
+  }
+}
+
+InfluenceList mergeInfluences(InfluenceList il1, InfluenceList il2,
+                              ShadowOpInfo* extra){
+  if (il1 == il2){
+    il2 = NULL;
+  }
+  if (il1 == NULL){
+    il1 = il2;
+    il2 = NULL;
+  }
+  if (il1 == NULL && extra == NULL) return NULL;
+  // Nothing to add, so we can share the list we already have.
+  if (il1 != NULL && il2 == NULL &&
+      (extra == NULL || hasInfluence(il1, extra))){
+    return ownInfluenceList(il1);
+  }
+  if (scratchInfluences == NULL){
+    scratchInfluences = mkInfluenceList();
   }
+  scratchInfluences->numWords = 0;
+  int numWords = 0;
+  if (il1 != NULL && il1->numWords > numWords){
+    numWords = il1->numWords;
+  }
+  if (il2 != NULL && il2->numWords > numWords){
+    numWords = il2->numWords;
+  }
+  if (extra != NULL && getInfluenceId(extra) / 64 + 1 > numWords){
+    numWords = getInfluenceId(extra) / 64 + 1;
+  }
+  reserveInfluenceWords(scratchInfluences, numWords);
+  ULong* words = scratchInfluences->words;
+  if (il1 != NULL){
+    for(int i = 0; i < il1->numWords; ++i){
+      words[i] |= il1->words[i];
+    }
+  }
+  if (il2 != NULL){
+    for(int i = 0; i < il2->numWords; ++i){
+      words[i] |= il2->words[i];
+    }
+  }
+  if (extra != NULL){
+    int id = getInfluenceId(extra);
+    words[id / 64] |= 1ULL << (id % 64);
+  }
+  return internScratchInfluences();
 }
 
-void assertNoDups(InfluenceList influences){
-  for(int i = 0; i < influences->length; ++i){
-    for(int j = i+1; j < influences->length; ++j){
-      if (influences->data[i] == influences->data[j]){
-        VG_(printf)("Influence #%d (", i);
-        printOpInfo(influences->data[i]);
-        VG_(printf)(") and influence #%d (", j);
-        printOpInfo(influences->data[j]);
-        VG_(printf)(" are the same!\n");
-        VG_(printf)("In list:\n");
-        ppInfluences(influences);
-      }
-      tl_assert(influences->data[i] != influences->data[j]);
+InfluenceList addInfluence(InfluenceList il, ShadowOpInfo* influence){
+  InfluenceList result = mergeInfluences(il, NULL, influence);
+  disownInfluenceList(il);
+  return result;
+}
+
+// Returns the smallest influence id in the list greater than prevId,
+// or -1 if there isn't one. Pass -1 to get the first.
+int nextInfluenceId(InfluenceList il, int prevId){
+  if (il == NULL){
+    return -1;
+  }
+  int id = prevId + 1;
+  int wordIdx = id / 64;
+  if (wordIdx >= il->numWords){
+    return -1;
+  }
+  ULong word = il->words[wordIdx] & (~0ULL << (id % 64));
+  while(word == 0){
+    wordIdx++;
+    if (wordIdx >= il->numWords){
+      return -1;
     }
+    word = il->words[wordIdx];
+  }
+  return wordIdx * 64 + __builtin_ctzll(word);
+}
+
+int numInfluences(InfluenceList il){
+  if (il == NULL){
+    return 0;
+  }
+  int count = 0;
+  for(int i = 0; i < il->numWords; ++i){
+    count += __builtin_popcountll(il->words[i]);
+  }
+  return count;
+}
+
+Int cmpInfluenceRank(const void* a, const void* b);
+Int cmpInfluenceRank(const void* a, const void* b){
+  ShadowOpInfo* info1 = *(ShadowOpInfo* const*)a;
+  ShadowOpInfo* info2 = *(ShadowOpInfo* const*)b;
+  if (info1->agg.local_error.max_error > info2->agg.local_error.max_error){
+    return -1;
+  } else if (info1->agg.local_error.max_error <
+             info2->agg.local_error.max_error){
+    return 1;
+  } else {
+    return -cmpInfo(info1, info2);
+  }
+}
+
+// Puts the worst max_influences influences in the list, by max local
+// error, into a freshly allocated array, and returns how many there
+// were. The caller frees the array.
+int rankInfluences(InfluenceList il, ShadowOpInfo*** ranked_out){
+  int count = numInfluences(il);
+  ShadowOpInfo** ranked =
+    VG_(malloc)("ranked influences", sizeof(ShadowOpInfo*) * (count + 1));
+  int i = 0;
+  for(int id = nextInfluenceId(il, -1); id >= 0;
+      id = nextInfluenceId(il, id)){
+    ranked[i++] = influenceInfos[id];
+  }
+  tl_assert(i == count);
+  VG_(ssort)(ranked, count, sizeof(ShadowOpInfo*), cmpInfluenceRank);
+  *ranked_out = ranked;
+  return count < max_influences ? count : max_influences;
+}
+
+InfluenceList worstInfluences(InfluenceList il){
+  if (numInfluences(il) <= max_influences){
+    return ownInfluenceList(il);
+  }
+  ShadowOpInfo** ranked;
+  int numRanked = rankInfluences(il, &ranked);
+  InfluenceList result = NULL;
+  for(int i = 0; i < numRanked; ++i){
+    result = addInfluence(result, ranked[i]);
+  }
+  VG_(free)(ranked);
+  return result;
+}
+
+void ppInfluences(InfluenceList influences){
+  for(int id = nextInfluenceId(influences, -1); id >= 0;
+      id = nextInfluenceId(influences, id)){
+    VG_(printf)("* ");
+    printOpInfo(influenceInfos[id]);
+    VG_(printf)("\n");
   }
 }
 
 void assertNoDropInfluences(InfluenceList influences1,
                             InfluenceList influences2,
                             InfluenceList merged){
-  if (influences1 != NULL){
-    for(int i = 0; i < influences1->length; ++i){
-      Bool mergedHasAllFromFirstArg =
-        hasInfluence(merged, influences1->data[i]);
-      if (!mergedHasAllFromFirstArg){
-        VG_(printf)("Tried to merge:\n");
-        ppInfluences(influences1);
-        VG_(printf)("And:\n");
-        ppInfluences(influences2);
-        VG_(printf)("But got:\n");
-        ppInfluences(merged);
-      }
-      tl_assert(mergedHasAllFromFirstArg);
+  for(int id = nextInfluenceId(influences1, -1); id >= 0;
+      id = nextInfluenceId(influences1, id)){
+    Bool mergedHasAllFromFirstArg =
+      hasInfluence(merged, influenceInfos[id]);
+    if (!mergedHasAllFromFirstArg){
+      VG_(printf)("Tried to merge:\n");
+      ppInfluences(influences1);
+      VG_(printf)("And:\n");
+      ppInfluences(influences2);
+      VG_(printf)("But got:\n");
+      ppInfluences(merged);
     }
+    tl_assert(mergedHasAllFromFirstArg);
   }
-  if (influences2 != NULL){
-    for(int i = 0; i < influences2->length; ++i){
-      Bool mergedHasAllFromSecondArg =
-        hasInfluence(merged, influences2->data[i]);
-      if (!mergedHasAllFromSecondArg){
-        VG_(printf)("Tried to merge:\n");
-        ppInfluences(influences1);
-        VG_(printf)("And:\n");
-        ppInfluences(influences2);
-        VG_(printf)("But got:\n");
-        ppInfluences(merged);
-      }
-      tl_assert(mergedHasAllFromSecondArg);
+  for(int id = nextInfluenceId(influences2, -1); id >= 0;
+      id = nextInfluenceId(influences2, id)){
+    Bool mergedHasAllFromSecondArg =
+      hasInfluence(merged, influenceInfos[id]);
+    if (!mergedHasAllFromSecondArg){
+      VG_(printf)("Tried to merge:\n");
+      ppInfluences(influences1);
+      VG_(printf)("And:\n");
+      ppInfluences(influences2);
+      VG_(printf)("But got:\n");
+      ppInfluences(merged);
     }
+    tl_assert(mergedHasAllFromSecondArg);
   }
 }
 
 Bool hasInfluence(InfluenceList list, ShadowOpInfo* influence){
-  for(int i = 0; i < list->length; ++i){
-    if (list->data[i] == influence){
-      return True;
-    }
+  int id = influence->influence_id;
+  if (list == NULL || id < 0 || id / 64 >= list->numWords){
+    return False;
   }
-  return False;
+  return (list->words[id / 64] >> (id % 64)) & 1;
 }
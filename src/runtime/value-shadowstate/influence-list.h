@@ -32,21 +32,53 @@
 
 #include "../op-shadowstate/shadowop-info.h"
 
+// Sets of this many words or fewer are stored inline in the list,
+// larger ones spill to a separate buffer.
+#define INFLUENCE_INLINE_WORDS 2
+
+// Influence lists are bitsets over dense influence ids, which are
+// handed out to ops the first time they're flagged. This makes
+// merging a word-wise or, and keeps lists unbounded; we only pick
+// out the worst max_influences of them when we write output.
+//
+// Lists are immutable and interned, so two values with the same
+// influences share one list, and the empty set is always NULL. Hold
+// on to a list with ownInfluenceList, and let go of it with
+// disownInfluenceList.
 typedef struct _influenceList{
+  // For the intern table, and the pool of free lists.
   struct _influenceList* next;
-  int length;
-  ShadowOpInfo** data;
+  UWord hash;
+  UWord ref_count;
+  int numWords;
+  int capacity;
+  ULong* words;
+  ULong inlineWords[INFLUENCE_INLINE_WORDS];
 } *InfluenceList;
 
-InfluenceList mkInfluenceList(void);
-void freeInfluenceList(InfluenceList il);
+extern ShadowOpInfo** influenceInfos;
+extern int numInfluenceIds;
+
+int getInfluenceId(ShadowOpInfo* info);
+InfluenceList ownInfluenceList(InfluenceList il);
+void disownInfluenceList(InfluenceList il);
+// Returns an owned reference to the union of the arguments, any of
+// which can be NULL.
 InfluenceList mergeInfluences(InfluenceList il1, InfluenceList il2,
                               ShadowOpInfo* extra);
+// Consumes the reference to il, and returns an owned reference to il
+// plus influence.
+InfluenceList addInfluence(InfluenceList il, ShadowOpInfo* influence);
+int nextInfluenceId(InfluenceList il, int prevId);
+int numInfluences(InfluenceList il);
+int rankInfluences(InfluenceList il, ShadowOpInfo*** ranked_out);
+// Returns an owned reference to the list of just the influences
+// rankInfluences would pick out of il.
+InfluenceList worstInfluences(InfluenceList il);
 void ppInfluences(InfluenceList influences);
 void assertNoDropInfluences(InfluenceList influences1,
                             InfluenceList influences2,
                             InfluenceList merged);
 Bool hasInfluence(InfluenceList list, ShadowOpInfo* influence);
-void assertNoDups(InfluenceList influences);
 
 #endif
@@ -39,6 +39,7 @@
 void initRangeRecord(RangeRecord* record){
   initRange(&(record->pos_range));
   initRange(&(record->neg_range));
+  record->histogram = NULL;
 }
 
 void initRange(Range* range){
@@ -46,7 +47,49 @@ void initRange(Range* range){
   range->max = -INFINITY;
 }
 
+InputHistogram* mkInputHistogram(void){
+  InputHistogram* result =
+    VG_(perm_malloc)(sizeof(InputHistogram), vg_alignof(InputHistogram));
+  for(int i = 0; i < INPUT_HISTOGRAM_BINS; ++i){
+    result->counts[i] = 0;
+  }
+  return result;
+}
+
+void updateInputHistogram(InputHistogram* histogram, double value){
+  // The sign bit and the top of the exponent are exactly the bin
+  // index, so no branches needed.
+  ULong bits = *(ULong*)&value;
+  UInt* count = &(histogram->counts[bits >> (52 + INPUT_HISTOGRAM_BINADE_SHIFT)]);
+  *count += *count != 0xffffffff;
+}
+
+// Writes the non-empty bins of the histogram, each as a sign, the
+// range of binary exponents [lo, hi) that the bin covers, and a
+// count. The lowest positive and negative bins also include zeroes
+// and subnormals, and the highest include infinities and NaNs.
+void writeInputHistogram(BBuf* buf, InputHistogram* histogram){
+  for(int i = 0; i < INPUT_HISTOGRAM_BINS; ++i){
+    if (histogram->counts[i] == 0) continue;
+    int exponentBin = i % INPUT_HISTOGRAM_BINS_PER_SIGN;
+    int lo = (exponentBin << INPUT_HISTOGRAM_BINADE_SHIFT) - 1023;
+    int hi = ((exponentBin + 1) << INPUT_HISTOGRAM_BINADE_SHIFT) - 1023;
+    if (output_sexp){
+      printBBuf(buf, " (%s %d %d %u)",
+                i < INPUT_HISTOGRAM_BINS_PER_SIGN ? "+" : "-",
+                lo, hi, histogram->counts[i]);
+    } else {
+      printBBuf(buf, " %s[2^%d, 2^%d): %u",
+                i < INPUT_HISTOGRAM_BINS_PER_SIGN ? "" : "-",
+                lo, hi, histogram->counts[i]);
+    }
+  }
+}
+
 void updateRangeRecord(RangeRecord* range, double value){
+  if (range->histogram != NULL){
+    updateInputHistogram(range->histogram, value);
+  }
   if (value > 0 || !detailed_ranges){
     if (range->pos_range.min > value){
       range->pos_range.min = value;
@@ -75,6 +118,7 @@ void copyRangeRecordInPlace(RangeRecord* dest, RangeRecord* src){
   dest->pos_range.max = src->pos_range.max;
   dest->neg_range.min = src->neg_range.min;
   dest->neg_range.max = src->neg_range.max;
+  dest->histogram = src->histogram;
 }
 
 int nonTrivialRange(RangeRecord* range){
@@ -30,8 +30,23 @@
 #ifndef _RANGE_H
 #define _RANGE_H
 
+#include "pub_tool_basics.h"
 #include "../../helper/bbuf.h"
 
+// Input histograms bin values by their sign and the top bits of
+// their IEEE exponent, so that the bin index is just a shift of the
+// value's bits. Each bin covers 2^INPUT_HISTOGRAM_BINADE_SHIFT
+// binades; the positive bins come first, then the negative ones.
+// There's one of these for every argument of every op, so the counts
+// are kept to 32 bits, and stop at the top instead of wrapping.
+#define INPUT_HISTOGRAM_BINADE_SHIFT 2
+#define INPUT_HISTOGRAM_BINS_PER_SIGN (2048 >> INPUT_HISTOGRAM_BINADE_SHIFT)
+#define INPUT_HISTOGRAM_BINS (2 * INPUT_HISTOGRAM_BINS_PER_SIGN)
+
+typedef struct _InputHistogram {
+  UInt counts[INPUT_HISTOGRAM_BINS];
+} InputHistogram;
+
 typedef struct _Range {
   double min;
   double max;
@@ -40,11 +55,17 @@ typedef struct _Range {
 typedef struct _RangeRecord {
   Range neg_range;
   Range pos_range;
+  // Only set for operation input records, when --input-histograms is
+  // on. Copies of a record share its histogram.
+  InputHistogram* histogram;
 } RangeRecord;
 
 void updateRangeRecord(RangeRecord* range, double value);
 void initRangeRecord(RangeRecord* record);
 void initRange(Range* range);
+InputHistogram* mkInputHistogram(void);
+void updateInputHistogram(InputHistogram* histogram, double value);
+void writeInputHistogram(BBuf* buf, InputHistogram* histogram);
 RangeRecord* copyRangeRecord(RangeRecord* record);
 void copyRangeRecordInPlace(RangeRecord* dest, RangeRecord* src);
 int nonTrivialRange(RangeRecord* range);
@@ -67,6 +67,28 @@ double getDouble(Real real){
   #endif
 }
 
+Real doubleDoubleRemainder = NULL;
+void getDoubleDouble(Real real, double* hi, double* lo){
+  *hi = getDouble(real);
+  *lo = 0.0;
+  if (no_reals) return;
+  // There's no remainder to an infinity or NaN.
+  if (*hi - *hi != 0.0) return;
+  if (doubleDoubleRemainder == NULL){
+    doubleDoubleRemainder = mkReal();
+  }
+  #ifdef USE_MPFR
+  mpfr_sub_d(doubleDoubleRemainder->mpfr_val, real->mpfr_val, *hi,
+             MPFR_RNDN);
+  *lo = mpfr_get_d(doubleDoubleRemainder->mpfr_val, MPFR_RNDN);
+  #else
+  mpf_set_d(doubleDoubleRemainder->mpf_val, *hi);
+  mpf_sub(doubleDoubleRemainder->mpf_val, real->mpf_val,
+          doubleDoubleRemainder->mpf_val);
+  *lo = mpf_get_d(doubleDoubleRemainder->mpf_val);
+  #endif
+}
+
 int isNaN(Real real){
   if (no_reals) return 0;
   #ifdef USE_MPFR
@@ -83,6 +105,15 @@ int realCompare(Real real1, Real real2){
   #endif
 }
 
+Bool realsIdentical(Real real1, Real real2){
+  #ifdef USE_MPFR
+  return mpfr_equal_p(real1->mpfr_val, real2->mpfr_val) &&
+    !mpfr_signbit(real1->mpfr_val) == !mpfr_signbit(real2->mpfr_val);
+  #else
+  return mpf_cmp(real1->mpf_val, real2->mpf_val) == 0;
+  #endif
+}
+
 void copyReal(Real src, Real dest){
   #ifdef USE_MPFR
   mpfr_set(dest->mpfr_val, src->mpfr_val, MPFR_RNDN);
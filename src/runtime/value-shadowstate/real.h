@@ -53,8 +53,14 @@ Real mkReal(void);
 void setReal(Real r, double bytes);
 
 double getDouble(Real real);
+// Rounds real to the nearest double hi, and the rest of it to lo, so
+// that hi + lo is a double-double approximation of real.
+void getDoubleDouble(Real real, double* hi, double* lo);
 int isNaN(Real real);
 int realCompare(Real real1, Real real2);
+// Whether the two are exactly the same value, down to the sign of
+// zero.
+Bool realsIdentical(Real real1, Real real2);
 
 void freeReal(Real real);
 void copyReal(Real src, Real dest);
@@ -109,6 +109,21 @@ VG_REGPARM(2) void dynamicCleanup(int nentries, IRTemp* entries){
   }
   blockStateDirty = 0;
 }
+// Drops every shadow held in the thread state. Blocks run outside a
+// HERBGRIND_BEGIN/END region don't track register writes, so
+// whatever is left over from the last region can't be trusted once
+// we start shadowing again; the registers get fresh shadows from
+// their client values the next time they're used.
+void clearThreadStateShadows(void){
+  for(int tid = 0; tid < MAX_THREADS; ++tid){
+    for(int i = 0; i < MAX_REGISTERS; ++i){
+      if (shadowThreadState[tid][i] != NULL){
+        disownShadowValue(shadowThreadState[tid][i]);
+        shadowThreadState[tid][i] = NULL;
+      }
+    }
+  }
+}
 inline
 ShadowValue* getTS(Int idx){
   ShadowValue* result = shadowThreadState[VG_(get_running_tid)()][idx];
@@ -157,6 +172,90 @@ VG_REGPARM(1) ShadowValue* getMemShadow(Addr64 addr){
   }
   return NULL;
 }
+void forEachMemShadow(Addr start, SizeT len,
+                      void (*f)(Addr addr, ShadowValue* val, void* closure),
+                      void* closure){
+  // For small ranges, look up each float-sized slot, which only
+  // finds values at the same alignment as the start of the range.
+  // Past the size of the table it's cheaper to walk every bucket,
+  // which finds everything in range.
+  if (len / sizeof(float) < LARGE_PRIME){
+    for(SizeT offset = 0; offset < len; offset += sizeof(float)){
+      ShadowValue* val = getMemShadow(start + offset);
+      if (val != NULL){
+        f(start + offset, val, closure);
+      }
+    }
+  } else {
+    for(int i = 0; i < LARGE_PRIME; ++i){
+      for(TableValueEntry* node = shadowMemTable[i];
+          node != NULL; node = node->next){
+        if (node->addr >= start && node->addr - start < len &&
+            node->val != NULL){
+          f(node->addr, node->val, closure);
+        }
+      }
+    }
+  }
+}
+typedef struct _ExactValuesCopy {
+  Addr src;
+  double* dst;
+  SizeT elemSize;
+  HerbgrindExactFormat format;
+  SizeT numFound;
+} ExactValuesCopy;
+
+void copyExactValue(Addr addr, ShadowValue* val, void* closure);
+void copyExactValue(Addr addr, ShadowValue* val, void* closure){
+  ExactValuesCopy* copy = closure;
+  // Skip the second halves of doubles.
+  if ((addr - copy->src) % copy->elemSize != 0){
+    return;
+  }
+  SizeT idx = (addr - copy->src) / copy->elemSize;
+  copy->numFound += 1;
+  if (copy->format == HERBGRIND_EXACT_DOUBLE_DOUBLE){
+    getDoubleDouble(val->real, &(copy->dst[idx * 2]),
+                    &(copy->dst[idx * 2 + 1]));
+  } else {
+    copy->dst[idx] = getDouble(val->real);
+  }
+}
+SizeT getExactValues(Addr src, double* dst, SizeT count,
+                     Bool isSingle, HerbgrindExactFormat format){
+  SizeT width = format == HERBGRIND_EXACT_DOUBLE_DOUBLE ? 2 : 1;
+  SizeT dstLen = count * width * sizeof(double);
+  if (count == 0){
+    return 0;
+  }
+  // Clients can export in place, so src and dst might overlap. Build
+  // the results off to the side before touching dst or its shadows.
+  double* results = VG_(malloc)("exact values", dstLen);
+  // Start with the client values, and then overwrite the ones that
+  // have shadows.
+  for(SizeT i = 0; i < count; ++i){
+    results[i * width] =
+      isSingle ? ((float*)src)[i] : ((double*)src)[i];
+    if (width == 2){
+      results[i * width + 1] = 0.0;
+    }
+  }
+  ExactValuesCopy copy = {.src = src, .dst = results,
+                          .elemSize = isSingle ? sizeof(float) : sizeof(double),
+                          .format = format, .numFound = 0};
+  if (!no_reals){
+    forEachMemShadow(src, count * copy.elemSize, copyExactValue, &copy);
+  }
+  // We're writing behind the instrumentation's back, so drop any
+  // shadows that were sitting in the destination.
+  for(SizeT offset = 0; offset < dstLen; offset += sizeof(float)){
+    removeMemShadow((Addr)dst + offset);
+  }
+  VG_(memcpy)(dst, results, dstLen);
+  VG_(free)(results);
+  return copy.numFound;
+}
 VG_REGPARM(3) void setMemShadowTemp(Addr64 memDest,
                                     UWord size,
                                     ShadowTemp* st){
@@ -256,10 +355,8 @@ void freeShadowValue(ShadowValue* val){
   if (PRINT_VALUE_MOVES){
     VG_(printf)("Disowned last reference to %p! Freeing...\n", val);
   }
-  if (val->influences != NULL){
-    freeInfluenceList(val->influences);
-    val->influences = NULL;
-  }
+  disownInfluenceList(val->influences);
+  val->influences = NULL;
   if (!no_exprs){
     if (print_expr_refs){
       VG_(printf)("Disowning expression %p as part of freeing val %p\n",
@@ -286,8 +383,7 @@ ShadowValue* copyShadowValue(ShadowValue* val){
   }
   copy->expr = val->expr;
   if (!no_exprs){
-    recursivelyOwnConcExpr(copy->expr,
-                           max_expr_block_depth * 2);
+    ownConcExpr(copy->expr);
   }
   if (!no_influences){
     copy->influences = cloneInfluences(val->influences);
@@ -54,6 +54,7 @@
 #include "pub_tool_libcprint.h"
 
 #include "../../helper/stack.h"
+#include "../../include/herbgrind.h"
 
 #define MAX_THREADS 16
 
@@ -104,6 +105,7 @@ extern int blockStateDirty;
 
 void initValueShadowState(void);
 VG_REGPARM(2) void dynamicCleanup(int nentries, IRTemp* entries);
+void clearThreadStateShadows(void);
 VG_REGPARM(2) void dynamicPut(Int tsDest, ShadowTemp* st);
 VG_REGPARM(2) ShadowTemp* dynamicGet64(Int tsSrc,
                                        UWord tsBytes);
@@ -115,6 +117,14 @@ VG_REGPARM(0) TableValueEntry* newTableValueEntry(void);
 VG_REGPARM(3) void setMemShadowTemp(Addr64 memDest, UWord size,
                                     ShadowTemp* st);
 VG_REGPARM(1) ShadowValue* getMemShadow(Addr64 memSrc);
+// Calls f on every shadow value in the len bytes starting at start.
+void forEachMemShadow(Addr start, SizeT len,
+                      void (*f)(Addr addr, ShadowValue* val, void* closure),
+                      void* closure);
+// Writes the shadow values of the count doubles or floats at src to
+// dst, as GET_EXACT(F) describes, and returns how many there were.
+SizeT getExactValues(Addr src, double* dst, SizeT count,
+                     Bool isSingle, HerbgrindExactFormat format);
 void removeMemShadow(Addr64 addr);
 void addMemShadow(Addr64 addr, ShadowValue* val);
 
@@ -0,0 +1,267 @@
+/*--------------------------------------------------------------------*/
+/*--- Herbgrind: a valgrind tool for Herbie     output-intercept.c ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Herbgrind, a valgrind tool for diagnosing
+   floating point accuracy problems in binary programs and extracting
+   problematic expressions.
+
+   Copyright (C) 2016-2017 Alex Sanchez-Stern
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+
+#include "output-intercept.h"
+#include "../../options.h"
+#include "../value-shadowstate/value-shadowstate.h"
+#include "../op-shadowstate/marks.h"
+#include "../../helper/symbol-cache.h"
+#include "../../helper/runtime-util.h"
+
+#include "pub_tool_vki.h"
+#include "pub_tool_libcbase.h"
+#include "pub_tool_libcfile.h"
+#include "pub_tool_libcprint.h"
+#include "pub_tool_libcassert.h"
+#include "pub_tool_mallocfree.h"
+#include "pub_tool_options.h"
+#include "pub_tool_xarray.h"
+
+// Functions we know write floating point data out of the
+// program. MPI doesn't tell us the element size without looking at
+// the datatype, so we assume doubles; anything else can be given in
+// a spec file. HDF5 is left out, since how much H5Dwrite writes
+// depends on its dataspaces.
+//
+// Only the public names go here. Valgrind names an address after its
+// public alias when it has one, and the internal names like __write
+// or _M_insert are only called from inside the libraries, on data
+// we've already seen go by.
+OutputSpec defaultOutputSpecs[] = {
+  // name, buf, size, count, intCount, elemSize, fparg
+  {"fwrite", 0, 1, 2, False, 1, -1},
+  {"fwrite_unlocked", 0, 1, 2, False, 1, -1},
+  {"write", 1, 2, -1, False, 1, -1},
+  {"pwrite", 1, 2, -1, False, 1, -1},
+  {"pwrite64", 1, 2, -1, False, 1, -1},
+  {"send", 1, 2, -1, False, 1, -1},
+  {"sendto", 1, 2, -1, False, 1, -1},
+  {"MPI_Send", 0, -1, 1, True, sizeof(double), -1},
+  {"MPI_Ssend", 0, -1, 1, True, sizeof(double), -1},
+  {"MPI_Bsend", 0, -1, 1, True, sizeof(double), -1},
+  {"MPI_Rsend", 0, -1, 1, True, sizeof(double), -1},
+  {"MPI_Isend", 0, -1, 1, True, sizeof(double), -1},
+  // std::ostream::operator<<(double)
+  {"_ZNSolsEd", -1, -1, -1, False, 1, 0},
+};
+
+// Pointers to specs, so that the ones we've handed out to
+// instrumentation stay put as the array grows.
+XArray* outputSpecs = NULL;
+
+Bool parseSpecArg(const HChar* value, Int max, Int* out);
+Bool parseSpecArg(const HChar* value, Int max, Int* out){
+  HChar* end;
+  Long result = VG_(strtoll10)(value, &end);
+  if (end == value || *end != '\0' || result < 0 || result >= max){
+    return False;
+  }
+  *out = result;
+  return True;
+}
+
+Bool parseOutputSpecLine(HChar* line, OutputSpec* spec);
+Bool parseOutputSpecLine(HChar* line, OutputSpec* spec){
+  HChar* saveptr;
+  HChar* name = VG_(strtok_r)(line, " \t\r", &saveptr);
+  spec->fnname = VG_(strdup)("output spec name", name);
+  spec->bufArg = -1;
+  spec->sizeArg = -1;
+  spec->countArg = -1;
+  spec->intCount = False;
+  spec->elemSize = 1;
+  spec->fpArg = -1;
+  for(HChar* field = VG_(strtok_r)(NULL, " \t\r", &saveptr);
+      field != NULL; field = VG_(strtok_r)(NULL, " \t\r", &saveptr)){
+    if (VG_(strcmp)(field, "intcount") == 0){
+      spec->intCount = True;
+      continue;
+    }
+    HChar* value = VG_(strchr)(field, '=');
+    if (value == NULL){
+      return False;
+    }
+    *value = '\0';
+    value += 1;
+    Bool valid;
+    if (VG_(strcmp)(field, "buf") == 0){
+      valid = parseSpecArg(value, MAX_OUTPUT_INT_ARGS, &(spec->bufArg));
+    } else if (VG_(strcmp)(field, "size") == 0){
+      valid = parseSpecArg(value, MAX_OUTPUT_INT_ARGS, &(spec->sizeArg));
+    } else if (VG_(strcmp)(field, "count") == 0){
+      valid = parseSpecArg(value, MAX_OUTPUT_INT_ARGS, &(spec->countArg));
+    } else if (VG_(strcmp)(field, "fparg") == 0){
+      valid = parseSpecArg(value, MAX_OUTPUT_FP_ARGS, &(spec->fpArg));
+    } else if (VG_(strcmp)(field, "elemsize") == 0){
+      Int elemSize;
+      valid = parseSpecArg(value, 1 << 16, &elemSize) && elemSize > 0;
+      spec->elemSize = elemSize;
+    } else {
+      valid = False;
+    }
+    if (!valid){
+      return False;
+    }
+  }
+  // Either we write a single float argument, or a buffer with some
+  // way of knowing how big it is.
+  if (spec->fpArg >= 0){
+    return spec->bufArg < 0;
+  } else {
+    return spec->bufArg >= 0 &&
+      (spec->sizeArg >= 0 || spec->countArg >= 0);
+  }
+}
+
+void loadOutputSpecFile(const HChar* filename);
+void loadOutputSpecFile(const HChar* filename){
+  SysRes fileResult = VG_(open)(filename, VKI_O_RDONLY, 0);
+  if (sr_isError(fileResult)){
+    VG_(fmsg_bad_option)("--output-spec",
+                         "Couldn't open output spec file %s\n",
+                         filename);
+  }
+  Int fileD = sr_Res(fileResult);
+  struct vg_stat statBuf;
+  if (VG_(fstat)(fileD, &statBuf) != 0){
+    VG_(close)(fileD);
+    VG_(fmsg_bad_option)("--output-spec",
+                         "Couldn't read output spec file %s\n",
+                         filename);
+  }
+  HChar* contents = VG_(malloc)("output spec contents", statBuf.size + 1);
+  Int bytesRead = VG_(read)(fileD, contents, statBuf.size);
+  VG_(close)(fileD);
+  contents[bytesRead < 0 ? 0 : bytesRead] = '\0';
+
+  Int lineNum = 0;
+  HChar* lineStart = contents;
+  while(lineStart != NULL){
+    HChar* lineEnd = VG_(strchr)(lineStart, '\n');
+    if (lineEnd != NULL){
+      *lineEnd = '\0';
+    }
+    lineNum += 1;
+    HChar* line = lineStart;
+    lineStart = lineEnd == NULL ? NULL : lineEnd + 1;
+
+    while(VG_(isspace)(*line)){
+      line++;
+    }
+    if (*line == '\0' || *line == '#'){
+      continue;
+    }
+    OutputSpec* spec = VG_(perm_malloc)(sizeof(OutputSpec),
+                                        vg_alignof(OutputSpec));
+    if (parseOutputSpecLine(line, spec)){
+      VG_(addToXA)(outputSpecs, &spec);
+    } else {
+      VG_(umsg)("Ignoring malformed line %d in output spec file %s\n",
+                lineNum, filename);
+    }
+  }
+  VG_(free)(contents);
+}
+
+void initOutputSpecs(void){
+  outputSpecs = VG_(newXA)(VG_(malloc), "output specs",
+                           VG_(free), sizeof(OutputSpec*));
+  const int numDefaults = sizeof(defaultOutputSpecs) / sizeof(OutputSpec);
+  for(int i = 0; i < numDefaults; ++i){
+    OutputSpec* spec = &(defaultOutputSpecs[i]);
+    VG_(addToXA)(outputSpecs, &spec);
+  }
+  if (output_spec_filename != NULL){
+    loadOutputSpecFile(output_spec_filename);
+  }
+}
+
+OutputSpec* getOutputSpec(const char* fnname){
+  // Search backwards, so that specs from the file win over the
+  // built in ones.
+  for(Word i = VG_(sizeXA)(outputSpecs) - 1; i >= 0; --i){
+    OutputSpec* spec = *(OutputSpec**)VG_(indexXA)(outputSpecs, i);
+    if (VG_(strcmp)(spec->fnname, fnname) == 0){
+      return spec;
+    }
+  }
+  return NULL;
+}
+
+// The C and C++ runtimes call these functions themselves: fwrite
+// ends in a write, printf writes out the text it formatted, and
+// operator<< hands its double on to another overload. Those calls
+// only pass along data the program already sent through a function
+// we intercept, or text that isn't floating point at all, so we only
+// intercept calls made from outside the runtimes.
+Bool isRuntimeCallSite(Addr callAddr){
+  const HChar* objname = getSourceInfo(callAddr)->objname;
+  if (objname == NULL){
+    return False;
+  }
+  const HChar* basename = VG_(strrchr)(objname, '/');
+  basename = basename == NULL ? objname : basename + 1;
+  return isPrefix("libc.so", basename) ||
+    isPrefix("libc-", basename) ||
+    isPrefix("libstdc++.so", basename);
+}
+
+void interceptOutput(OutputSpec* spec, Addr stackPtr,
+                     UWord arg0, UWord arg1, UWord arg2, UWord arg3){
+  // We run on the first instruction of the function, so the return
+  // address is on top of the stack. Back up into the call
+  // instruction, like stack traces do.
+  Addr callAddr = *(Addr*)stackPtr - 1;
+  if (isRuntimeCallSite(callAddr)){
+    return;
+  }
+  if (spec->fpArg >= 0){
+    // For these the instrumentation passes us the bits of the float
+    // argument instead of the integer arguments.
+    union {UWord bits; double value;} clientValue = {.bits = arg0};
+    maybeMarkImportantAtAddr(getTS(FP_ARG_OFFSET(spec->fpArg)),
+                             clientValue.value, 0, 1, callAddr);
+    return;
+  }
+  UWord args[MAX_OUTPUT_INT_ARGS] = {arg0, arg1, arg2, arg3};
+  SizeT len = spec->elemSize;
+  if (spec->sizeArg >= 0){
+    len *= args[spec->sizeArg];
+  }
+  if (spec->countArg >= 0){
+    UWord count = args[spec->countArg];
+    if (spec->intCount){
+      Int intCount = (Int)count;
+      count = intCount < 0 ? 0 : intCount;
+    }
+    len *= count;
+  }
+  markOutputBuffer(callAddr, args[spec->bufArg], len);
+}
@@ -0,0 +1,88 @@
+/*--------------------------------------------------------------------*/
+/*--- Herbgrind: a valgrind tool for Herbie     output-intercept.h ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Herbgrind, a valgrind tool for diagnosing
+   floating point accuracy problems in binary programs and extracting
+   problematic expressions.
+
+   Copyright (C) 2016-2017 Alex Sanchez-Stern
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#ifndef _OUTPUT_INTERCEPT_H
+#define _OUTPUT_INTERCEPT_H
+
+#include "pub_tool_basics.h"
+
+// Describes a function that sends floating point values out of the
+// program, so that we can mark them as they leave. We recognize
+// these functions by name when we instrument their first
+// instruction, and look at their first four integer argument
+// registers whenever it runs. Matching on the function itself
+// instead of its call sites means calls through the PLT, or through
+// a pointer, are caught too. Calls made from inside libc and
+// libstdc++ are left alone.
+//
+// Besides the built in list, more can be given in a spec file with
+// --output-spec=<file>. Each line there is a function name followed
+// by some of:
+//
+//   buf=<n>       The buffer being written is integer argument n.
+//   size=<n>      Argument n is the size of the buffer in bytes, or of
+//                 each element if there's also a count.
+//   count=<n>     Argument n is the number of elements in the buffer.
+//   elemsize=<n>  Each element is n bytes.
+//   intcount      The count argument is a C int instead of a size_t.
+//   fparg=<n>     Instead of a buffer, the function writes a single
+//                 double, passed as floating point argument n.
+//
+// Arguments are numbered from zero. Lines starting with # are
+// comments, and entries in the file override built in ones with the
+// same name. For instance, the built in entry for fwrite is:
+//
+//   fwrite buf=0 size=1 count=2
+typedef struct _OutputSpec {
+  const char* fnname;
+  Int bufArg;
+  Int sizeArg;
+  Int countArg;
+  Bool intCount;
+  SizeT elemSize;
+  Int fpArg;
+} OutputSpec;
+
+// We only pass this many integer argument registers to
+// interceptOutput.
+#define MAX_OUTPUT_INT_ARGS 4
+#define MAX_OUTPUT_FP_ARGS 8
+// Where the nth floating point argument lives in the amd64 thread
+// state.
+#define FP_ARG_OFFSET(n) (224 + 32 * (n))
+
+void initOutputSpecs(void);
+OutputSpec* getOutputSpec(const char* fnname);
+Bool isRuntimeCallSite(Addr callAddr);
+// Called at the start of an output function, with the stack pointer
+// and argument registers.
+void interceptOutput(OutputSpec* spec, Addr stackPtr,
+                     UWord arg0, UWord arg1, UWord arg2, UWord arg3);
+
+#endif